@@ -201,6 +201,57 @@ template bool GenerateWeightsN(RawVector<Weights<4>>& dst, IArray<int> bone_indi
 template bool GenerateWeightsN(RawVector<Weights<8>>& dst, IArray<int> bone_indices, IArray<float> bone_weights, int bones_per_vertex);
 
 
+namespace impl {
+
+void BuildWeldMap(ConnectionData& connection, const IArray<float3>& vertices)
+{
+    auto& weld_map = connection.weld_map;
+    auto& weld_counts = connection.weld_counts;
+    auto& weld_offsets = connection.weld_offsets;
+    auto& weld_indices = connection.weld_indices;
+
+    int n = (int)vertices.size();
+    weld_map.resize_discard(n);
+    weld_counts.resize_discard(n);
+    weld_offsets.resize_discard(n);
+    weld_indices.resize_discard(n);
+
+    // coincident vertices are listed in ascending order including the vertex itself,
+    // so the first one is the lowest indexed vertex coincident with it.
+    {
+        PointHashGrid grid;
+        grid.build(vertices, 0.0000001f);
+
+        RawVector<int> offsets, neighbors;
+        grid.gatherAll(offsets, neighbors);
+        parallel_for_blocked(0, n, 1024, [&](int vi, int vend) {
+            for (; vi < vend; ++vi) {
+                weld_map[vi] = neighbors[offsets[vi]];
+            }
+        });
+    }
+
+    weld_counts.zeroclear();
+    for (int vi : weld_map) {
+        weld_counts[vi]++;
+    }
+
+    int offset = 0;
+    for (int vi = 0; vi < n; ++vi) {
+        weld_offsets[vi] = offset;
+        offset += weld_counts[vi];
+    }
+
+    weld_counts.zeroclear();
+    for (int vi = 0; vi < n; ++vi) {
+        int mvi = weld_map[vi];
+        int i = weld_offsets[mvi] + weld_counts[mvi]++;
+        weld_indices[i] = vi;
+    }
+}
+
+} // namespace impl
+
 void ConnectionData::clear()
 {
     v2f_counts.clear();
@@ -244,6 +295,292 @@ void ConnectionData::buildConnection(
     }
 }
 
+void ConnectionData::buildWeldMap(const IArray<float3>& vertices_)
+{
+    impl::BuildWeldMap(*this, vertices_);
+}
+
+
+namespace impl {
+
+// Body: [](int i0, int i1) -> void
+template<class Indices, class Counts, class Offsets, class Body>
+static inline void EachFaceEdge(const Indices& indices, const Counts& counts, const Offsets& offsets, const Body& body)
+{
+    int num_faces = (int)counts.size();
+    for (int fi = 0; fi < num_faces; ++fi) {
+        int c = counts[fi];
+        if (c < 3) { continue; }
+        int fo = offsets[fi];
+        for (int ci = 0; ci < c; ++ci) {
+            int i0 = indices[fo + ci];
+            int i1 = indices[fo + (ci + 1 == c ? 0 : ci + 1)];
+            if (i0 != i1) { body(i0, i1); }
+        }
+    }
+}
+
+// labels vertices connected by edges with union-find. edges are united in parallel.
+// the larger root is always linked to the smaller one, so each root is the smallest vertex of its group
+// and the result doesn't depend on the order of unions. groups are numbered in order of their smallest vertex.
+// vertices that are not members are labeled -1. both ends of connected edges must be members.
+// Member: [](int vi) -> bool, Connected: [](int ei) -> bool
+template<class Member, class Connected>
+static void LabelConnectedVertices(const EdgeTable& edges, const Member& member, const Connected& connected,
+    RawVector<int>& labels, RawVector<int>& group_offsets, RawVector<int>& group_vertices)
+{
+    int num_vertices = edges.num_vertices;
+    std::unique_ptr<std::atomic<int>[]> parents(new std::atomic<int>[num_vertices]);
+    parallel_for_blocked(0, num_vertices, 1024, [&](int vi, int vend) {
+        for (; vi < vend; ++vi) { parents[vi].store(vi); }
+    });
+
+    auto find = [&](int v) {
+        for (;;) {
+            int p = parents[v].load();
+            if (p == v) { return v; }
+            int gp = parents[p].load();
+            if (gp != p) { parents[v].compare_exchange_weak(p, gp); } // path halving
+            v = gp;
+        }
+    };
+    auto unite = [&](int a, int b) {
+        for (;;) {
+            a = find(a);
+            b = find(b);
+            if (a == b) { return; }
+            if (a > b) { std::swap(a, b); }
+            // fails if b is no longer a root. retry from the new root
+            int expected = b;
+            if (parents[b].compare_exchange_strong(expected, a)) { return; }
+        }
+    };
+    parallel_for_blocked(0, num_vertices, 1024, [&](int vi, int vend) {
+        for (; vi < vend; ++vi) {
+            for (int ei = edges.edge_offsets[vi]; ei < edges.edge_offsets[vi + 1]; ++ei) {
+                if (connected(ei)) { unite(vi, edges.edge_ends[ei]); }
+            }
+        }
+    });
+
+    // roots are smaller than the other vertices of their groups, so they are numbered first
+    labels.resize_discard(num_vertices);
+    parallel_for_blocked(0, num_vertices, 1024, [&](int vi, int vend) {
+        for (; vi < vend; ++vi) { labels[vi] = member(vi) ? find(vi) : -1; }
+    });
+    group_offsets.clear();
+    group_offsets.push_back(0);
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        int root = labels[vi];
+        if (root < 0) { continue; }
+        if (root == vi) {
+            labels[vi] = (int)group_offsets.size() - 1;
+            group_offsets.push_back(0);
+        }
+        else {
+            labels[vi] = labels[root];
+        }
+        ++group_offsets[labels[vi] + 1];
+    }
+    int num_groups = (int)group_offsets.size() - 1;
+    for (int gi = 0; gi < num_groups; ++gi) {
+        group_offsets[gi + 1] += group_offsets[gi];
+    }
+    group_vertices.resize_discard(group_offsets.back());
+    RawVector<int> pos;
+    pos.assign(group_offsets.begin(), group_offsets.end() - 1);
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        if (labels[vi] >= 0) { group_vertices[pos[labels[vi]]++] = vi; }
+    }
+}
+
+template<class Indices, class Counts, class Offsets>
+static void BuildEdgeTable(EdgeTable& dst, const Indices& indices, const Counts& counts, const Offsets& offsets, int num_vertices)
+{
+    dst.clear();
+    if (num_vertices <= 0) { return; }
+    dst.num_vertices = num_vertices;
+
+    // edges of faces grouped by their smaller end. duplicates are edges shared by faces.
+    RawVector<int> face_edge_offsets, face_edge_ends;
+    face_edge_offsets.resize_zeroclear(num_vertices + 1);
+    EachFaceEdge(indices, counts, offsets, [&](int i0, int i1) {
+        ++face_edge_offsets[std::min(i0, i1) + 1];
+    });
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        face_edge_offsets[vi + 1] += face_edge_offsets[vi];
+    }
+    face_edge_ends.resize_discard(face_edge_offsets.back());
+    {
+        RawVector<int> pos;
+        pos.assign(face_edge_offsets.begin(), face_edge_offsets.end() - 1);
+        EachFaceEdge(indices, counts, offsets, [&](int i0, int i1) {
+            face_edge_ends[pos[std::min(i0, i1)]++] = std::max(i0, i1);
+        });
+    }
+
+    // unique edges. the number of faces using an edge is the number of its duplicates.
+    auto& edge_offsets = dst.edge_offsets;
+    edge_offsets.resize_discard(num_vertices + 1);
+    edge_offsets[0] = 0;
+    parallel_for_blocked(0, num_vertices, 1024, [&](int vi, int vend) {
+        for (; vi < vend; ++vi) {
+            int begin = face_edge_offsets[vi], end = face_edge_offsets[vi + 1];
+            std::sort(face_edge_ends.begin() + begin, face_edge_ends.begin() + end);
+            int n = 0;
+            for (int i = begin; i < end; ++i) {
+                if (i == begin || face_edge_ends[i] != face_edge_ends[i - 1]) { ++n; }
+            }
+            edge_offsets[vi + 1] = n;
+        }
+    });
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        edge_offsets[vi + 1] += edge_offsets[vi];
+    }
+    int num_edges = edge_offsets.back();
+    dst.edge_ends.resize_discard(num_edges);
+    dst.edge_faces.resize_discard(num_edges);
+    dst.boundary_edges.resize_discard(num_edges);
+    parallel_for_blocked(0, num_vertices, 1024, [&](int vi, int vend) {
+        for (; vi < vend; ++vi) {
+            int begin = face_edge_offsets[vi], end = face_edge_offsets[vi + 1];
+            int ei = edge_offsets[vi] - 1;
+            for (int i = begin; i < end; ++i) {
+                if (i == begin || face_edge_ends[i] != face_edge_ends[i - 1]) {
+                    ++ei;
+                    dst.edge_ends[ei] = face_edge_ends[i];
+                    dst.edge_faces[ei] = 0;
+                }
+                ++dst.edge_faces[ei];
+            }
+        }
+    });
+
+    dst.boundary_vertices.resize_zeroclear(num_vertices);
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        for (int ei = edge_offsets[vi]; ei < edge_offsets[vi + 1]; ++ei) {
+            bool boundary = dst.edge_faces[ei] == 1;
+            dst.boundary_edges[ei] = boundary;
+            if (boundary) {
+                dst.boundary_vertices[vi] = true;
+                dst.boundary_vertices[dst.edge_ends[ei]] = true;
+            }
+        }
+    }
+
+    // neighbors. smaller ones are added first, so each list is ascending.
+    auto& neighbor_offsets = dst.neighbor_offsets;
+    neighbor_offsets.resize_zeroclear(num_vertices + 1);
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        for (int ei = edge_offsets[vi]; ei < edge_offsets[vi + 1]; ++ei) {
+            ++neighbor_offsets[vi + 1];
+            ++neighbor_offsets[dst.edge_ends[ei] + 1];
+        }
+    }
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        neighbor_offsets[vi + 1] += neighbor_offsets[vi];
+    }
+    dst.neighbors.resize_discard(neighbor_offsets.back());
+    dst.neighbor_edges.resize_discard(neighbor_offsets.back());
+    {
+        RawVector<int> pos;
+        pos.assign(neighbor_offsets.begin(), neighbor_offsets.end() - 1);
+        for (int vi = 0; vi < num_vertices; ++vi) {
+            for (int ei = edge_offsets[vi]; ei < edge_offsets[vi + 1]; ++ei) {
+                int ve = dst.edge_ends[ei];
+                int i = pos[vi]++;
+                dst.neighbors[i] = ve;
+                dst.neighbor_edges[i] = ei;
+                i = pos[ve]++;
+                dst.neighbors[i] = vi;
+                dst.neighbor_edges[i] = ei;
+            }
+        }
+    }
+
+    // boundary loops are components of boundary vertices connected by boundary edges
+    LabelConnectedVertices(dst,
+        [&](int vi) { return dst.boundary_vertices[vi]; },
+        [&](int ei) { return dst.boundary_edges[ei]; },
+        dst.vertex_loops, dst.loop_offsets, dst.loop_vertices);
+
+    LabelConnectedVertices(dst,
+        [&](int) { return true; },
+        [&](int) { return true; },
+        dst.vertex_components, dst.component_offsets, dst.component_vertices);
+}
+
+} // namespace impl
+
+void EdgeTable::clear()
+{
+    num_vertices = 0;
+    edge_offsets.clear();
+    edge_ends.clear();
+    edge_faces.clear();
+    boundary_edges.clear();
+    boundary_vertices.clear();
+    neighbor_offsets.clear();
+    neighbors.clear();
+    neighbor_edges.clear();
+    loop_offsets.clear();
+    loop_vertices.clear();
+    vertex_loops.clear();
+    component_offsets.clear();
+    component_vertices.clear();
+    vertex_components.clear();
+}
+
+bool EdgeTable::empty() const
+{
+    return edge_offsets.empty();
+}
+
+void EdgeTable::build(const IArray<int>& indices, int ngon, int num_vertices_)
+{
+    impl::CountsC counts{ ngon, indices.size() / ngon };
+    impl::OffsetsC offsets{ ngon, indices.size() / ngon };
+    impl::BuildEdgeTable(*this, indices, counts, offsets, num_vertices_);
+}
+
+void EdgeTable::build(const IArray<int>& indices, const IArray<int>& counts, const IArray<int>& offsets, int num_vertices_)
+{
+    impl::BuildEdgeTable(*this, indices, counts, offsets, num_vertices_);
+}
+
+void EdgeTable::buildWelded(const IArray<int>& indices_, int ngon, const IArray<int>& weld_map)
+{
+    impl::IndicesW indices{ indices_, weld_map };
+    impl::CountsC counts{ ngon, indices_.size() / ngon };
+    impl::OffsetsC offsets{ ngon, indices_.size() / ngon };
+    impl::BuildEdgeTable(*this, indices, counts, offsets, (int)weld_map.size());
+}
+
+void EdgeTable::buildWelded(const IArray<int>& indices_, const IArray<int>& counts, const IArray<int>& offsets, const IArray<int>& weld_map)
+{
+    impl::IndicesW indices{ indices_, weld_map };
+    impl::BuildEdgeTable(*this, indices, counts, offsets, (int)weld_map.size());
+}
+
+int EdgeTable::numLoops() const
+{
+    return loop_offsets.empty() ? 0 : (int)loop_offsets.size() - 1;
+}
+
+int EdgeTable::numComponents() const
+{
+    return component_offsets.empty() ? 0 : (int)component_offsets.size() - 1;
+}
+
+int EdgeTable::findEdge(int i0, int i1) const
+{
+    if (i1 < i0) { std::swap(i0, i1); }
+    auto begin = edge_ends.begin() + edge_offsets[i0];
+    auto end = edge_ends.begin() + edge_offsets[i0 + 1];
+    auto it = std::lower_bound(begin, end, i1);
+    return it != end && *it == i1 ? (int)(it - edge_ends.begin()) : -1;
+}
+
 
 bool OnEdge(const IArray<int>& indices, int ngon, const IArray<float3>& vertices, const ConnectionData& connection, int vertex_index)
 {
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <memory>
+#include <functional>
 #include "muRawVector.h"
 #include "muIntrusiveArray.h"
 #include "muMath.h"
@@ -56,6 +57,8 @@ struct ConnectionData
         const IArray<int>& indices, int ngon, const IArray<float3>& vertices, bool welding = false);
     void buildConnection(
         const IArray<int>& indices, const IArray<int>& counts, const IArray<int>& offsets, const IArray<float3>& vertices, bool welding = false);
+    // builds only weld_*
+    void buildWeldMap(const IArray<float3>& vertices);
 
     // Body: [](int face_index, int index_index) -> void
     template<class Body>
@@ -80,6 +83,96 @@ struct ConnectionData
     }
 };
 
+// undirected edges of faces and boundaries made of edges used by only one face. faces with less than 3 vertices are ignored.
+// this depends only on topology (and weld map), so it can be kept while vertices are moved.
+struct EdgeTable
+{
+    int num_vertices = 0;
+    RawVector<int> edge_offsets;        // edges whose smaller end is vertex vi: [edge_offsets[vi], edge_offsets[vi + 1])
+    RawVector<int> edge_ends;           // larger end of each edge
+    RawVector<int> edge_faces;          // number of faces using each edge
+    RawVector<bool> boundary_edges;     // edges used by only one face
+    RawVector<bool> boundary_vertices;  // vertices on boundary edges
+
+    RawVector<int> neighbor_offsets;    // neighbors of vertex vi: [neighbor_offsets[vi], neighbor_offsets[vi + 1]). ascending
+    RawVector<int> neighbors;
+    RawVector<int> neighbor_edges;      // edge between the vertex and each neighbor
+
+    // boundary loops: boundary vertices connected by boundary edges, numbered in order of their smallest vertex.
+    // a loop may branch on non-manifold meshes.
+    RawVector<int> loop_offsets;        // vertices of loop li: [loop_offsets[li], loop_offsets[li + 1])
+    RawVector<int> loop_vertices;       // ascending
+    RawVector<int> vertex_loops;        // loop of each vertex. -1 if not on boundary
+
+    // connected components (vertices connected by edges), numbered in order of their smallest vertex.
+    // if built by buildWelded(), vertices that are not weld representatives are isolated.
+    RawVector<int> component_offsets;   // vertices of component ci: [component_offsets[ci], component_offsets[ci + 1])
+    RawVector<int> component_vertices;  // ascending
+    RawVector<int> vertex_components;   // component of each vertex
+
+    void clear();
+    bool empty() const;
+    void build(const IArray<int>& indices, int ngon, int num_vertices);
+    void build(const IArray<int>& indices, const IArray<int>& counts, const IArray<int>& offsets, int num_vertices);
+    // each vertex vi is replaced by weld_map[vi] (see ConnectionData::weld_map), so coincident vertices share edges.
+    void buildWelded(const IArray<int>& indices, int ngon, const IArray<int>& weld_map);
+    void buildWelded(const IArray<int>& indices, const IArray<int>& counts, const IArray<int>& offsets, const IArray<int>& weld_map);
+
+    int numLoops() const;
+    int numComponents() const;
+    // returns -1 if i0 and i1 are not connected
+    int findEdge(int i0, int i1) const;
+
+    // Body: [](int vertex_index, int edge_index) -> void
+    template<class Body>
+    void eachNeighbor(int vi, const Body& body) const
+    {
+        int end = neighbor_offsets[vi + 1];
+        for (int i = neighbor_offsets[vi]; i < end; ++i) {
+            body(neighbors[i], neighbor_edges[i]);
+        }
+    }
+
+    // Body: [](int vertex_index) -> void
+    template<class Body>
+    void eachLoopVertex(int li, const Body& body) const
+    {
+        int end = loop_offsets[li + 1];
+        for (int i = loop_offsets[li]; i < end; ++i) {
+            body(loop_vertices[i]);
+        }
+    }
+
+    // Body: [](int vertex_index) -> void
+    template<class Body>
+    void eachComponentVertex(int ci, const Body& body) const
+    {
+        int end = component_offsets[ci + 1];
+        for (int i = component_offsets[ci]; i < end; ++i) {
+            body(component_vertices[i]);
+        }
+    }
+};
+
+// distances from seed vertices along edges, bounded by max_distance (Dijkstra). paths along edges zigzag on flat regions
+// and overestimate distances, so the straight line from the previous vertex over two edges is also tried.
+// buffers are kept between runs and entries are valid only if their stamp matches, so a run costs only the visited vertices.
+struct GeodesicFront
+{
+    int stamp = 0;
+    RawVector<int> stamps;          // run that reached each vertex
+    RawVector<int> settled_stamps;  // run that settled each vertex
+    RawVector<float> distances;
+    RawVector<int> parents;         // previous vertex on the path. -1 if seeded
+    RawVector<std::pair<float, int>> heap;
+    RawVector<std::pair<int, float>> settled; // settled vertices and their distances, in ascending order of distance. each once
+
+    // seeds start at their distance from origin.
+    // Position: [](int vertex_index) -> float3
+    template<class Position>
+    void run(const EdgeTable& edges, const int *seeds, int num_seeds, float3 origin, float max_distance, const Position& position);
+};
+
 bool OnEdge(const IArray<int>& indices, int ngon, const IArray<float3>& vertices, const ConnectionData& connection, int vertex_index);
 bool OnEdge(const IArray<int>& indices, const IArray<int>& counts, const IArray<int>& offsets, const IArray<float3>& vertices, const ConnectionData& connection, int vertex_index);
 
@@ -107,6 +200,15 @@ template<class Handler>
 void SelectConnected(const IArray<int>& indices, const IArray<int>& counts, const IArray<int>& offsets, const IArray<float3>& vertices,
     const IArray<int>& vertex_indices, const Handler& handler);
 
+// same as above with prebuilt tables.
+// edges of SelectHole() must be built by EdgeTable::buildWelded() with the weld map of connection.
+template<class Handler>
+void SelectEdge(const EdgeTable& edges, const IArray<int>& vertex_indices, const Handler& handler);
+template<class Handler>
+void SelectHole(const EdgeTable& edges, const ConnectionData& connection, const IArray<int>& vertex_indices, const Handler& handler);
+template<class Handler>
+void SelectConnected(const EdgeTable& edges, const IArray<int>& vertex_indices, const Handler& handler);
+
 
 // ------------------------------------------------------------
 // impl
@@ -339,3 +441,7 @@ inline uint32_t Float4ToColor32(const float4& c)
 
 #include "MeshUtils_impl.h"
 #include "muMeshRefiner.h"
+#include "muBVH.h"
+#include "muDepthBuffer.h"
+#include "muPointGrid.h"
+#include "muPolygonMask.h"
@@ -78,50 +78,8 @@ inline void BuildConnection(
     }
 }
 
-inline void BuildWeldMap(
-    ConnectionData& connection, const IArray<float3>& vertices)
-{
-    auto& weld_map = connection.weld_map;
-    auto& weld_counts = connection.weld_counts;
-    auto& weld_offsets = connection.weld_offsets;
-    auto& weld_indices = connection.weld_indices;
-
-    int n = (int)vertices.size();
-    weld_map.resize_discard(n);
-    weld_counts.resize_discard(n);
-    weld_offsets.resize_discard(n);
-    weld_indices.resize_discard(n);
-
-    parallel_for(0, n, [&](int vi) {
-        int r = vi;
-        float3 p = vertices[vi];
-        for (int i = 0; i < vi; ++i) {
-            if (length(vertices[i] - p) < 0.0000001f) {
-                r = i;
-                break;
-            }
-        }
-        weld_map[vi] = r;
-    });
-
-    weld_counts.zeroclear();
-    for (int vi : weld_map) {
-        weld_counts[vi]++;
-    }
-
-    int offset = 0;
-    for (int vi = 0; vi < n; ++vi) {
-        weld_offsets[vi] = offset;
-        offset += weld_counts[vi];
-    }
-
-    weld_counts.zeroclear();
-    for (int vi = 0; vi < n; ++vi) {
-        int mvi = weld_map[vi];
-        int i = weld_offsets[mvi] + weld_counts[mvi]++;
-        weld_indices[i] = vi;
-    }
-}
+// maps each vertex to the first vertex coincident with it (may be itself)
+void BuildWeldMap(ConnectionData& connection, const IArray<float3>& vertices);
 
 template<class Indices, class Counts, class Offsets>
 inline bool OnEdgeImpl(const Indices& indices, const Counts& counts, const Offsets& offsets, const IArray<float3>& vertices, const ConnectionData& connection, int vertex_index)
@@ -177,31 +135,33 @@ inline bool IsEdgeOpenedImpl(
     return num_connection == 2;
 }
 
-template<class Indices, class Counts, class Offsets>
 class SelectEdgeImpl
 {
 public:
-    SelectEdgeImpl(const Indices& indices_, const Counts& counts_, const Offsets& offsets_, const IArray<float3>& vertices_,
-        const ConnectionData& connection_)
-        : indices(indices_)
-        , counts(counts_)
-        , offsets(offsets_)
-        , connection(connection_)
+    SelectEdgeImpl(const EdgeTable& edges_)
+        : edges(edges_)
     {
-        checked.resize(vertices_.size());
-        checked.zeroclear();
+        checked_loops.resize(edges.numLoops());
+        checked_loops.zeroclear();
+        checked_components.resize(edges.numComponents());
+        checked_components.zeroclear();
     }
 
     template<class Handler>
     void selectEdge(int vertex_index, const Handler& handler)
     {
-        selectEdgeImpl(vertex_index, handler);
+        int li = edges.vertex_loops[vertex_index];
+        if (li < 0 || checked_loops[li]) { return; }
+
+        checked_loops[li] = true;
+        edges.eachLoopVertex(li, handler);
     }
 
+    // edges must be welded by connection.weld_map
     template<class Handler>
-    void selectHole(int vertex_index, const Handler& handler)
+    void selectHole(int vertex_index, const ConnectionData& connection, const Handler& handler)
     {
-        selectEdgeImpl(vertex_index, [&](int vi) {
+        selectEdge(connection.weld_map[vertex_index], [&](int vi) {
             connection.eachWeldedVertices(vi, [&](int i) {
                 handler(i);
             });
@@ -211,113 +171,97 @@ public:
     template<class Handler>
     void selectConnected(int vertex_index, const Handler& handler)
     {
-        next_points.push_back(vertex_index);
-
-        while (!next_points.empty()) {
-            int vi = next_points.back();
-            next_points.pop_back();
-
-            if (checked[vi]) { continue; }
-
-            checked[vi] = true;
-            handler(vi);
+        int ci = edges.vertex_components[vertex_index];
+        if (checked_components[ci]) { return; }
 
-            connection.eachConnectedFaces(vi, [&](int fi, int ii) {
-                int fo = offsets[fi];
-                int c = counts[fi];
-                int nth = ii - fo;
-
-                int f0 = nth;
-                int f1 = f0 - 1; if (f1 < 0) { f1 = c - 1; }
-                int f2 = f0 + 1; if (f2 == c) { f2 = 0; }
-
-                next_points.push_back(indices[fo + f1]);
-                next_points.push_back(indices[fo + f2]);
-            });
-        }
+        checked_components[ci] = true;
+        edges.eachComponentVertex(ci, handler);
     }
 
 private:
+    const EdgeTable& edges;
 
-    template<class Handler>
-    void selectEdgeImpl(int vertex_index, const Handler& handler)
-    {
-        if (checked[vertex_index]) { return; }
-
-        auto checkConnectedEdges = [&](int vi) {
-            connection.eachConnectedFaces(vi, [&](int fi, int ii) {
-                int fo = offsets[fi];
-                int c = counts[fi];
-                int nth = ii - fo;
-
-                int f0 = nth;
-                int f1 = f0 - 1; if (f1 < 0) { f1 = c - 1; }
-                int f2 = f0 + 1; if (f2 == c) { f2 = 0; }
-
-                next_edges.push_back({ indices[fo + f0], indices[fo + f1] });
-                next_edges.push_back({ indices[fo + f0], indices[fo + f2] });
-            });
-        };
-
-
-        checkConnectedEdges(vertex_index);
+    RawVector<bool> checked_loops;
+    RawVector<bool> checked_components;
+};
 
-        while (!next_edges.empty()) {
-            int i0 = next_edges.back().first;
-            int i1 = next_edges.back().second;
-            next_edges.pop_back();
+} // namespace impl
 
-            if (checked[i0] && checked[i1]) { continue; }
 
-            if (IsEdgeOpenedImpl(indices, counts, offsets, connection, i0, i1)) {
-                if (!checked[i0]) { checked[i0] = true; handler(i0); }
-                if (!checked[i1]) { checked[i1] = true; handler(i1); }
-                checkConnectedEdges(i1);
-            }
-        }
+template<class Position>
+inline void GeodesicFront::run(const EdgeTable& edges, const int *seeds, int num_seeds, float3 origin, float max_distance, const Position& position)
+{
+    int num_vertices = edges.num_vertices;
+    if ((int)stamps.size() != num_vertices || stamp == std::numeric_limits<int>::max()) {
+        stamps.resize_discard(num_vertices);
+        stamps.zeroclear();
+        settled_stamps.resize_discard(num_vertices);
+        settled_stamps.zeroclear();
+        distances.resize_discard(num_vertices);
+        parents.resize_discard(num_vertices);
+        stamp = 0;
     }
-
-    const Indices& indices;
-    const Counts& counts;
-    const Offsets& offsets;
-    const ConnectionData& connection;
-
-    RawVector<bool> checked;
-    RawVector<std::pair<int, int>> next_edges;
-    RawVector<int> next_points;
-};
-
-} // namespace impl
+    int s = ++stamp;
+    heap.clear();
+    settled.clear();
+
+    auto cmp = std::greater<std::pair<float, int>>();
+    auto push = [&](int vi, float d, int parent) {
+        if (d > max_distance || settled_stamps[vi] == s || (stamps[vi] == s && distances[vi] <= d)) { return; }
+        stamps[vi] = s;
+        distances[vi] = d;
+        parents[vi] = parent;
+        heap.push_back({ d, vi });
+        std::push_heap(heap.begin(), heap.end(), cmp);
+    };
+    for (int i = 0; i < num_seeds; ++i) {
+        push(seeds[i], length(position(seeds[i]) - origin), -1);
+    }
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), cmp);
+        auto top = heap.back();
+        heap.pop_back();
+        float d = top.first;
+        int vi = top.second;
+        if (settled_stamps[vi] == s || d > distances[vi]) { continue; } // superseded by a shorter path
+        settled_stamps[vi] = s;
+        settled.push_back({ vi, d });
+
+        // the shortcut can be shorter than d. distances are clamped to d so that vertices are settled in ascending order.
+        float3 p = position(vi);
+        int pa = parents[vi];
+        float3 pp = pa >= 0 ? position(pa) : origin;
+        float pd = pa >= 0 ? distances[pa] : 0.0f;
+        edges.eachNeighbor(vi, [&](int ni, int) {
+            float3 np = position(ni);
+            push(ni, std::max(d, std::min(d + length(np - p), pd + length(np - pp))), vi);
+        });
+    }
+}
 
 
 template<class Handler>
 inline void SelectEdge(const IArray<int>& indices, int ngon, const IArray<float3>& vertices,
     const IArray<int>& vertex_indices, const Handler& handler)
 {
-    impl::CountsC counts{ ngon, indices.size() / ngon };
-    impl::OffsetsC offsets{ ngon, indices.size() / ngon };
-
-    ConnectionData connection;
-    impl::BuildConnection(connection, indices, counts, vertices);
-
-    impl::SelectEdgeImpl<decltype(indices), decltype(counts), decltype(offsets)>
-        impl(indices, counts, offsets, vertices, connection);
-
-    for (int i : vertex_indices) {
-        impl.selectEdge(i, handler);
-    }
+    EdgeTable edges;
+    edges.build(indices, ngon, (int)vertices.size());
+    SelectEdge(edges, vertex_indices, handler);
 }
 
 template<class Handler>
 inline void SelectEdge(const IArray<int>& indices, const IArray<int>& counts, const IArray<int>& offsets, const IArray<float3>& vertices,
     const IArray<int>& vertex_indices, const Handler& handler)
 {
-    ConnectionData connection;
-    impl::BuildConnection(connection, indices, counts, vertices);
-
-    impl::SelectEdgeImpl<decltype(indices), decltype(counts), decltype(offsets)>
-        impl(indices, counts, offsets, vertices, connection);
+    EdgeTable edges;
+    edges.build(indices, counts, offsets, (int)vertices.size());
+    SelectEdge(edges, vertex_indices, handler);
+}
 
+template<class Handler>
+inline void SelectEdge(const EdgeTable& edges, const IArray<int>& vertex_indices, const Handler& handler)
+{
+    impl::SelectEdgeImpl impl(edges);
     for (int i : vertex_indices) {
         impl.selectEdge(i, handler);
     }
@@ -325,41 +269,35 @@ inline void SelectEdge(const IArray<int>& indices, const IArray<int>& counts, co
 
 
 template<class Handler>
-inline void SelectHole(const IArray<int>& indices_, int ngon, const IArray<float3>& vertices,
+inline void SelectHole(const IArray<int>& indices, int ngon, const IArray<float3>& vertices,
     const IArray<int>& vertex_indices, const Handler& handler)
 {
-    impl::CountsC counts{ ngon, indices_.size() / ngon };
-    impl::OffsetsC offsets{ ngon, indices_.size() / ngon };
-
     ConnectionData connection;
-    impl::BuildWeldMap(connection, vertices);
-
-    impl::IndicesW indices{ indices_, connection.weld_map };
-    impl::BuildConnection(connection, indices, counts, vertices);
-
-    impl::SelectEdgeImpl<decltype(indices), decltype(counts), decltype(offsets)>
-        impl(indices, counts, offsets, vertices, connection);
+    connection.buildWeldMap(vertices);
 
-    for (int i : vertex_indices) {
-        impl.selectHole(i, handler);
-    }
+    EdgeTable edges;
+    edges.buildWelded(indices, ngon, connection.weld_map);
+    SelectHole(edges, connection, vertex_indices, handler);
 }
 
 template<class Handler>
-inline void SelectHole(const IArray<int>& indices_, const IArray<int>& counts, const IArray<int>& offsets, const IArray<float3>& vertices,
+inline void SelectHole(const IArray<int>& indices, const IArray<int>& counts, const IArray<int>& offsets, const IArray<float3>& vertices,
     const IArray<int>& vertex_indices, const Handler& handler)
 {
     ConnectionData connection;
-    impl::BuildWeldMap(connection, vertices);
-
-    impl::IndicesW indices{ indices_, connection.weld_map };
-    impl::BuildConnection(connection, indices, counts, vertices);
+    connection.buildWeldMap(vertices);
 
-    impl::SelectEdgeImpl<decltype(indices), decltype(counts), decltype(offsets)>
-        impl(indices, counts, offsets, vertices, connection);
+    EdgeTable edges;
+    edges.buildWelded(indices, counts, offsets, connection.weld_map);
+    SelectHole(edges, connection, vertex_indices, handler);
+}
 
+template<class Handler>
+inline void SelectHole(const EdgeTable& edges, const ConnectionData& connection, const IArray<int>& vertex_indices, const Handler& handler)
+{
+    impl::SelectEdgeImpl impl(edges);
     for (int i : vertex_indices) {
-        impl.selectHole(i, handler);
+        impl.selectHole(i, connection, handler);
     }
 }
 
@@ -368,30 +306,24 @@ template<class Handler>
 inline void SelectConnected(const IArray<int>& indices, int ngon, const IArray<float3>& vertices,
     const IArray<int>& vertex_indices, const Handler& handler)
 {
-    impl::CountsC counts{ ngon, indices.size() / ngon };
-    impl::OffsetsC offsets{ ngon, indices.size() / ngon };
-
-    ConnectionData connection;
-    impl::BuildConnection(connection, indices, counts, vertices);
-
-    impl::SelectEdgeImpl<decltype(indices), decltype(counts), decltype(offsets)>
-        impl(indices, counts, offsets, vertices, connection);
-
-    for (int i : vertex_indices) {
-        impl.selectConnected(i, handler);
-    }
+    EdgeTable edges;
+    edges.build(indices, ngon, (int)vertices.size());
+    SelectConnected(edges, vertex_indices, handler);
 }
 
 template<class Handler>
 inline void SelectConnected(const IArray<int>& indices, const IArray<int>& counts, const IArray<int>& offsets, const IArray<float3>& vertices,
     const IArray<int>& vertex_indices, const Handler& handler)
 {
-    ConnectionData connection;
-    impl::BuildConnection(connection, indices, counts, vertices);
-
-    impl::SelectEdgeImpl<decltype(indices), decltype(counts), decltype(offsets)>
-        impl(indices, counts, offsets, vertices, connection);
+    EdgeTable edges;
+    edges.build(indices, counts, offsets, (int)vertices.size());
+    SelectConnected(edges, vertex_indices, handler);
+}
 
+template<class Handler>
+inline void SelectConnected(const EdgeTable& edges, const IArray<int>& vertex_indices, const Handler& handler)
+{
+    impl::SelectEdgeImpl impl(edges);
     for (int i : vertex_indices) {
         impl.selectConnected(i, handler);
     }
@@ -346,6 +346,18 @@ static inline uniform bool ray_triangle_intersection(uniform float3 pos, uniform
         distance >= 0.0f;
 }
 
+// 1 / dir for slab tests. near-zero components are replaced by +-eps to avoid inf * 0 = NaN.
+static inline uniform float safe_inv(uniform float v)
+{
+    uniform const float eps = 1e-20f;
+    return 1.0f / (abs(v) < eps ? (v < 0.0f ? -eps : eps) : v);
+}
+static inline uniform float3 safe_inv_dir(uniform float3 dir)
+{
+    uniform float3 r = { safe_inv(dir.x), safe_inv(dir.y), safe_inv(dir.z) };
+    return r;
+}
+
 
 static inline float ray_point_distance(float3 pos, float3 dir, float3 p)
 {
@@ -0,0 +1,1202 @@
+#include "pch.h"
+#include "MeshUtils.h"
+
+namespace mu {
+
+static const int BVHNumBins = 16;
+static const int BVHMaxLeafTriangles = 8;
+static const int BVHMaxSAHDepth = 64;
+static const int BVHMaxStack = 128;
+static const int BVHParallelSplitTriangles = 1 << 16; // nodes with more triangles are split by parallel scans
+static const int BVHSubtreeTasks = 32; // top levels are split until there are this many nodes. then each is built as a task
+
+static inline float3 min3(const float3& a, const float3& b) { return{ std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z) }; }
+static inline float3 max3(const float3& a, const float3& b) { return{ std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z) }; }
+
+static inline float HalfArea(const float3& bmin, const float3& bmax)
+{
+    float3 e = bmax - bmin;
+    return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+static inline bool RayAABB(const float3& pos, const float3& idir, const float3& bmin, const float3& bmax, float tmax, float& tnear)
+{
+    float3 t1 = (bmin - pos) * idir;
+    float3 t2 = (bmax - pos) * idir;
+    float3 tn = min3(t1, t2);
+    float3 tf = max3(t1, t2);
+    float n = std::max(std::max(tn.x, tn.y), tn.z);
+    float f = std::min(std::min(tf.x, tf.y), tf.z);
+    tnear = n;
+    return n <= f && f >= 0.0f && n <= tmax;
+}
+
+static inline float PointAABBDistanceSq(const float3& pos, const float3& bmin, const float3& bmax)
+{
+    float3 d = max3(max3(bmin - pos, pos - bmax), float3::zero());
+    return dot(d, d);
+}
+
+
+void TriangleBVH::clear()
+{
+    nodes.clear();
+    tri_indices.clear();
+    for (auto& a : soa) { a.clear(); }
+}
+
+bool TriangleBVH::empty() const
+{
+    return nodes.empty();
+}
+
+int TriangleBVH::numTriangles() const
+{
+    return (int)tri_indices.size();
+}
+
+// soa: triangle positions (p1.xyz, p2.xyz, p3.xyz)
+static void GetTriangleBounds(const RawVector<float> *soa, int i, float3& bmin, float3& bmax)
+{
+    float3 p1 = { soa[0][i], soa[1][i], soa[2][i] };
+    float3 p2 = { soa[3][i], soa[4][i], soa[5][i] };
+    float3 p3 = { soa[6][i], soa[7][i], soa[8][i] };
+    bmin = min3(min3(p1, p2), p3);
+    bmax = max3(max3(p1, p2), p3);
+
+    // ray_triangle_intersection() accepts hits slightly outside of the triangle. expand bounds to cover them.
+    float3 e = bmax - bmin;
+    float pad = std::max(std::max(e.x, e.y), e.z) * 4e-4f + 1e-6f;
+    bmin -= pad;
+    bmax += pad;
+}
+
+// copies triangle positions into SoA arrays in the order of tri_indices
+static void GatherTriangles(RawVector<float> *soa, const RawVector<int>& tri_indices, const IArray<int>& indices, const IArray<float3>& vertices)
+{
+    int num_triangles = (int)tri_indices.size();
+    for (int i = 0; i < 9; ++i) { soa[i].resize_discard(num_triangles); }
+
+    parallel_for_blocked(0, num_triangles, 1024, [&](int ti, int tend) {
+        for (; ti < tend; ++ti) {
+            int src = tri_indices[ti];
+            for (int i = 0; i < 3; ++i) {
+                auto& p = vertices[indices[src * 3 + i]];
+                soa[i * 3 + 0][ti] = p.x;
+                soa[i * 3 + 1][ti] = p.y;
+                soa[i * 3 + 2][ti] = p.z;
+            }
+        }
+    });
+}
+
+
+void TriangleBVH::getTriangleBounds(int i, float3& bmin, float3& bmax) const
+{
+    GetTriangleBounds(soa, i, bmin, bmax);
+}
+
+void TriangleBVH::updateTriangles(const IArray<int>& indices, const IArray<float3>& vertices)
+{
+    GatherTriangles(soa, tri_indices, indices, vertices);
+}
+
+void TriangleBVH::updateBounds()
+{
+    // children are always placed after their parent. so updating in reverse order is bottom-up.
+    for (int ni = (int)nodes.size() - 1; ni >= 0; --ni) {
+        auto& node = nodes[ni];
+        if (node.count > 0) {
+            float3 bmin, bmax;
+            getTriangleBounds(node.first, node.bb_min, node.bb_max);
+            for (int i = 1; i < node.count; ++i) {
+                getTriangleBounds(node.first + i, bmin, bmax);
+                node.bb_min = min3(node.bb_min, bmin);
+                node.bb_max = max3(node.bb_max, bmax);
+            }
+        }
+        else {
+            auto& l = nodes[node.first];
+            auto& r = nodes[node.first + 1];
+            node.bb_min = min3(l.bb_min, r.bb_min);
+            node.bb_max = max3(l.bb_max, r.bb_max);
+        }
+    }
+}
+
+struct BVHBin { float3 bb_min, bb_max; int count; };
+struct BVHBounds { float3 bb_min, bb_max, c_min, c_max; };
+
+// bounds of triangles and their centers
+static void ScanBounds(const int *tris, int count, const float3 *tri_min, const float3 *tri_max, const float3 *tri_center, BVHBounds& dst)
+{
+    dst.bb_min = tri_min[tris[0]]; dst.bb_max = tri_max[tris[0]];
+    dst.c_min = dst.c_max = tri_center[tris[0]];
+    for (int i = 1; i < count; ++i) {
+        int t = tris[i];
+        dst.bb_min = min3(dst.bb_min, tri_min[t]);
+        dst.bb_max = max3(dst.bb_max, tri_max[t]);
+        dst.c_min = min3(dst.c_min, tri_center[t]);
+        dst.c_max = max3(dst.c_max, tri_center[t]);
+    }
+}
+
+// SAH bins of each axis whose scale is > 0
+static void ScanBins(const int *tris, int count, const float3 *tri_min, const float3 *tri_max, const float3 *tri_center,
+    const float3& cmin, const float3& scale, BVHBin (*dst)[BVHNumBins])
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        for (auto& b : dst[axis]) { b.bb_min = float3{ FLT_MAX, FLT_MAX, FLT_MAX }; b.bb_max = -b.bb_min; b.count = 0; }
+        if (scale[axis] <= 0.0f) { continue; }
+        for (int i = 0; i < count; ++i) {
+            int t = tris[i];
+            int bi = std::min(int((tri_center[t][axis] - cmin[axis]) * scale[axis]), BVHNumBins - 1);
+            auto& b = dst[axis][bi];
+            b.bb_min = min3(b.bb_min, tri_min[t]);
+            b.bb_max = max3(b.bb_max, tri_max[t]);
+            ++b.count;
+        }
+    }
+}
+
+// decides how to split triangles of a node and partitions them. returns the number of triangles of the left child, or -1 if the node should be a leaf.
+// large nodes are scanned by blocks in parallel. bounds and bins don't depend on the order of merging, so the result is the same.
+static int SplitTriangles(int *tris, int count, int depth, const float3 *tri_min, const float3 *tri_max, const float3 *tri_center)
+{
+    if (count <= 2) { return -1; }
+
+    int num_blocks = count >= BVHParallelSplitTriangles ? ceildiv(count, BVHParallelSplitTriangles / 4) : 1;
+    int block_size = ceildiv(count, num_blocks);
+
+    BVHBounds bounds;
+    if (num_blocks == 1) {
+        ScanBounds(tris, count, tri_min, tri_max, tri_center, bounds);
+    }
+    else {
+        RawVector<BVHBounds> block_bounds;
+        block_bounds.resize_discard(num_blocks);
+        parallel_for(0, num_blocks, [&](int bi) {
+            int first = bi * block_size;
+            ScanBounds(tris + first, std::min(block_size, count - first), tri_min, tri_max, tri_center, block_bounds[bi]);
+        });
+        bounds = block_bounds[0];
+        for (int bi = 1; bi < num_blocks; ++bi) {
+            auto& b = block_bounds[bi];
+            bounds.bb_min = min3(bounds.bb_min, b.bb_min);
+            bounds.bb_max = max3(bounds.bb_max, b.bb_max);
+            bounds.c_min = min3(bounds.c_min, b.c_min);
+            bounds.c_max = max3(bounds.c_max, b.c_max);
+        }
+    }
+    float3 bmin = bounds.bb_min, bmax = bounds.bb_max;
+    float3 cmin = bounds.c_min, cmax = bounds.c_max;
+
+    int mid = -1;
+    float3 cext = cmax - cmin;
+    if (depth < BVHMaxSAHDepth) {
+        // binned SAH
+        float3 scale;
+        for (int axis = 0; axis < 3; ++axis) {
+            scale[axis] = cext[axis] > 0.0f ? float(BVHNumBins) / cext[axis] : 0.0f;
+        }
+
+        BVHBin bins[3][BVHNumBins];
+        if (num_blocks == 1) {
+            ScanBins(tris, count, tri_min, tri_max, tri_center, cmin, scale, bins);
+        }
+        else {
+            RawVector<BVHBin> block_bins;
+            block_bins.resize_discard(num_blocks * 3 * BVHNumBins);
+            parallel_for(0, num_blocks, [&](int bi) {
+                int first = bi * block_size;
+                ScanBins(tris + first, std::min(block_size, count - first), tri_min, tri_max, tri_center, cmin, scale,
+                    (BVHBin(*)[BVHNumBins])&block_bins[bi * 3 * BVHNumBins]);
+            });
+            for (int i = 0; i < 3 * BVHNumBins; ++i) {
+                auto& dst = bins[i / BVHNumBins][i % BVHNumBins];
+                dst = block_bins[i];
+                for (int bi = 1; bi < num_blocks; ++bi) {
+                    auto& b = block_bins[bi * 3 * BVHNumBins + i];
+                    dst.bb_min = min3(dst.bb_min, b.bb_min);
+                    dst.bb_max = max3(dst.bb_max, b.bb_max);
+                    dst.count += b.count;
+                }
+            }
+        }
+
+        int best_axis = -1, best_split = 0;
+        float best_cost = FLT_MAX;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (cext[axis] <= 0.0f) { continue; }
+
+            auto& axis_bins = bins[axis];
+            float area_r[BVHNumBins];
+            int count_r[BVHNumBins];
+            {
+                float3 rmin = axis_bins[BVHNumBins - 1].bb_min, rmax = axis_bins[BVHNumBins - 1].bb_max;
+                int rc = 0;
+                for (int bi = BVHNumBins - 1; bi > 0; --bi) {
+                    rmin = min3(rmin, axis_bins[bi].bb_min);
+                    rmax = max3(rmax, axis_bins[bi].bb_max);
+                    rc += axis_bins[bi].count;
+                    area_r[bi] = rc > 0 ? HalfArea(rmin, rmax) : 0.0f;
+                    count_r[bi] = rc;
+                }
+            }
+            {
+                float3 lmin = axis_bins[0].bb_min, lmax = axis_bins[0].bb_max;
+                int lc = 0;
+                for (int bi = 1; bi < BVHNumBins; ++bi) {
+                    lmin = min3(lmin, axis_bins[bi - 1].bb_min);
+                    lmax = max3(lmax, axis_bins[bi - 1].bb_max);
+                    lc += axis_bins[bi - 1].count;
+                    if (lc == 0 || count_r[bi] == 0) { continue; }
+                    float cost = HalfArea(lmin, lmax) * lc + area_r[bi] * count_r[bi];
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_split = bi;
+                    }
+                }
+            }
+        }
+
+        if (best_axis != -1) {
+            // traversal cost is considered equal to one triangle test
+            float leaf_cost = HalfArea(bmin, bmax) * count;
+            float split_cost = HalfArea(bmin, bmax) + best_cost;
+            if (count <= BVHMaxLeafTriangles && split_cost >= leaf_cost) { return -1; }
+
+            auto *p = std::partition(tris, tris + count, [&](int t) {
+                return std::min(int((tri_center[t][best_axis] - cmin[best_axis]) * scale[best_axis]), BVHNumBins - 1) < best_split;
+            });
+            mid = int(p - tris);
+        }
+    }
+
+    if (mid <= 0 || mid >= count) {
+        // degenerated or too deep. fallback to median split
+        int axis = cext.x >= cext.y && cext.x >= cext.z ? 0 : (cext.y >= cext.z ? 1 : 2);
+        mid = count / 2;
+        std::nth_element(tris, tris + mid, tris + count, [&](int a, int b) {
+            return tri_center[a][axis] < tri_center[b][axis];
+        });
+    }
+
+    return mid;
+}
+
+void TriangleBVH::build(const IArray<int>& indices, const IArray<float3>& vertices)
+{
+    clear();
+    int num_triangles = (int)indices.size() / 3;
+    if (num_triangles == 0) { return; }
+
+    tri_indices.resize(num_triangles);
+    std::iota(tri_indices.begin(), tri_indices.end(), 0);
+    updateTriangles(indices, vertices);
+
+    RawVector<float3> tri_min, tri_max, tri_center;
+    tri_min.resize_discard(num_triangles);
+    tri_max.resize_discard(num_triangles);
+    tri_center.resize_discard(num_triangles);
+    parallel_for_blocked(0, num_triangles, 1024, [&](int ti, int tend) {
+        for (; ti < tend; ++ti) {
+            getTriangleBounds(ti, tri_min[ti], tri_max[ti]);
+            tri_center[ti] = (tri_min[ti] + tri_max[ti]) * 0.5f;
+        }
+    });
+
+    // split the top levels level by level. nodes in the same level are independent, so they are processed in parallel,
+    // and the large splits of the first levels scan their triangles in parallel.
+    // children are appended in level order, so they are always placed after their parent.
+    RawVector<int> level, next, mids;
+    nodes.reserve(num_triangles * 2);
+    nodes.push_back({ float3::zero(), 0, float3::zero(), num_triangles });
+    level.push_back(0);
+
+    int depth = 0;
+    for (; !level.empty() && (int)level.size() < BVHSubtreeTasks; ++depth) {
+        int num_level_nodes = (int)level.size();
+        mids.resize_discard(num_level_nodes);
+        parallel_for(0, num_level_nodes, [&](int i) {
+            const auto& node = nodes[level[i]];
+            mids[i] = SplitTriangles(tri_indices.data() + node.first, node.count, depth,
+                tri_min.data(), tri_max.data(), tri_center.data());
+        });
+
+        next.clear();
+        for (int i = 0; i < num_level_nodes; ++i) {
+            if (mids[i] < 0) { continue; }
+
+            int ni = level[i];
+            int first = nodes[ni].first;
+            int count = nodes[ni].count;
+            int mid = mids[i];
+            int left = (int)nodes.size();
+            nodes.push_back({ float3::zero(), first, float3::zero(), mid });
+            nodes.push_back({ float3::zero(), first + mid, float3::zero(), count - mid });
+            nodes[ni].first = left;
+            nodes[ni].count = 0;
+            next.push_back(left);
+            next.push_back(left + 1);
+        }
+        std::swap(level, next);
+    }
+
+    // then the subtree of each remaining node is built by a task without synchronizing per level, into its own nodes.
+    // subtrees are appended in order, so the tree doesn't depend on scheduling.
+    int num_subtrees = (int)level.size();
+    std::vector<RawVector<Node>> subtrees(num_subtrees);
+    parallel_for(0, num_subtrees, [&](int si) {
+        auto& dst = subtrees[si];
+        dst.push_back(nodes[level[si]]);
+        struct Entry { int node, depth; };
+        RawVector<Entry> stack;
+        stack.push_back({ 0, depth });
+        while (!stack.empty()) {
+            auto e = stack.back();
+            stack.pop_back();
+            int first = dst[e.node].first;
+            int count = dst[e.node].count;
+            int mid = SplitTriangles(tri_indices.data() + first, count, e.depth,
+                tri_min.data(), tri_max.data(), tri_center.data());
+            if (mid < 0) { continue; }
+
+            int left = (int)dst.size();
+            dst.push_back({ float3::zero(), first, float3::zero(), mid });
+            dst.push_back({ float3::zero(), first + mid, float3::zero(), count - mid });
+            dst[e.node].first = left;
+            dst[e.node].count = 0;
+            stack.push_back({ left + 1, e.depth + 1 });
+            stack.push_back({ left, e.depth + 1 });
+        }
+    });
+    for (int si = 0; si < num_subtrees; ++si) {
+        // local node i (> 0) is placed at base + i - 1. the root replaces the node it was built from.
+        auto& src = subtrees[si];
+        int base = (int)nodes.size();
+        auto fix = [&](Node n) {
+            if (n.count == 0) { n.first += base - 1; }
+            return n;
+        };
+        nodes[level[si]] = fix(src[0]);
+        for (int i = 1; i < (int)src.size(); ++i) {
+            nodes.push_back(fix(src[i]));
+        }
+    }
+
+    // reorder triangles in node order
+    updateTriangles(indices, vertices);
+    updateBounds();
+}
+
+void TriangleBVH::refit(const IArray<int>& indices, const IArray<float3>& vertices)
+{
+    if (nodes.empty()) { return; }
+    updateTriangles(indices, vertices);
+    updateBounds();
+}
+
+bool TriangleBVH::raycast(float3 pos, float3 dir, int& tindex, float& distance) const
+{
+    if (nodes.empty()) { return false; }
+
+    float3 idir = safe_inv_dir(dir);
+    float best = FLT_MAX;
+    int hit = -1;
+
+    struct Entry { int node; float tnear; };
+    Entry stack[BVHMaxStack];
+    int sp = 0;
+
+    float tnear;
+    if (!RayAABB(pos, idir, nodes[0].bb_min, nodes[0].bb_max, best, tnear)) { return false; }
+    stack[sp++] = { 0, tnear };
+
+    while (sp > 0) {
+        auto e = stack[--sp];
+        if (e.tnear > best) { continue; }
+
+        auto& node = nodes[e.node];
+        if (node.count > 0) {
+            int end = node.first + node.count;
+            for (int i = node.first; i < end; ++i) {
+                float d;
+                if (ray_triangle_intersection(pos, dir,
+                    { soa[0][i], soa[1][i], soa[2][i] },
+                    { soa[3][i], soa[4][i], soa[5][i] },
+                    { soa[6][i], soa[7][i], soa[8][i] }, d))
+                {
+                    // on tie, pick smaller triangle index to match brute force
+                    int ti = tri_indices[i];
+                    if (d < best || (d == best && ti < hit)) {
+                        best = d;
+                        hit = ti;
+                    }
+                }
+            }
+        }
+        else {
+            int l = node.first, r = node.first + 1;
+            float tl, tr;
+            bool hl = RayAABB(pos, idir, nodes[l].bb_min, nodes[l].bb_max, best, tl);
+            bool hr = RayAABB(pos, idir, nodes[r].bb_min, nodes[r].bb_max, best, tr);
+            // push far child first so that near child is visited first
+            if (hl && hr) {
+                if (tl <= tr) {
+                    stack[sp++] = { r, tr };
+                    stack[sp++] = { l, tl };
+                }
+                else {
+                    stack[sp++] = { l, tl };
+                    stack[sp++] = { r, tr };
+                }
+            }
+            else if (hl) { stack[sp++] = { l, tl }; }
+            else if (hr) { stack[sp++] = { r, tr }; }
+        }
+    }
+
+    if (hit != -1) {
+        tindex = hit;
+        distance = best;
+        return true;
+    }
+    return false;
+}
+
+bool TriangleBVH::occluded(float3 pos, float3 dir, float max_distance, const int *indices, int ignore_vertex) const
+{
+    if (nodes.empty()) { return false; }
+
+    float3 idir = safe_inv_dir(dir);
+    int stack[BVHMaxStack];
+    int sp = 0;
+    stack[sp++] = 0;
+
+    while (sp > 0) {
+        auto& node = nodes[stack[--sp]];
+        float tnear;
+        if (!RayAABB(pos, idir, node.bb_min, node.bb_max, max_distance, tnear)) { continue; }
+
+        if (node.count > 0) {
+            int end = node.first + node.count;
+            for (int i = node.first; i < end; ++i) {
+                const int *tri = &indices[tri_indices[i] * 3];
+                if (tri[0] == ignore_vertex || tri[1] == ignore_vertex || tri[2] == ignore_vertex) { continue; }
+
+                float d;
+                if (ray_triangle_intersection(pos, dir,
+                    { soa[0][i], soa[1][i], soa[2][i] },
+                    { soa[3][i], soa[4][i], soa[5][i] },
+                    { soa[6][i], soa[7][i], soa[8][i] }, d) && d < max_distance)
+                {
+                    return true;
+                }
+            }
+        }
+        else {
+            stack[sp++] = node.first + 1;
+            stack[sp++] = node.first;
+        }
+    }
+    return false;
+}
+
+
+// local space of the BVH as is
+struct BVHIdentitySpace
+{
+    float3 point(float3 p) const { return p; }
+    float distanceSq(float3 pos, const TriangleBVH::Node& node) const
+    {
+        return PointAABBDistanceSq(pos, node.bb_min, node.bb_max);
+    }
+};
+
+// affine transform of the local space. node bounds are replaced by the bounds of the transformed boxes,
+// which contain the transformed triangles. so distances to them are still lower bounds.
+struct BVHTransformedSpace
+{
+    float4x4 m;
+    float3 point(float3 p) const { return mul_p(m, p); }
+    float distanceSq(float3 pos, const TriangleBVH::Node& node) const
+    {
+        float3 c = (node.bb_min + node.bb_max) * 0.5f;
+        float3 e = (node.bb_max - node.bb_min) * 0.5f;
+        float3 tc = mul_p(m, c);
+        float3 te;
+        for (int i = 0; i < 3; ++i) {
+            te[i] = std::abs(m[0][i]) * e.x + std::abs(m[1][i]) * e.y + std::abs(m[2][i]) * e.z;
+            // margin for rounding errors of the transformed vertices
+            te[i] += (std::abs(tc[i]) + te[i]) * 1e-5f;
+        }
+        return PointAABBDistanceSq(pos, tc - te, tc + te);
+    }
+};
+
+template<class Space>
+static bool ClosestPointImpl(const TriangleBVH& bvh, const Space& space, float3 pos, float max_distance, TriangleBVH::Hit& hit)
+{
+    auto& nodes = bvh.nodes;
+    auto& soa = bvh.soa;
+    hit.tindex = -1;
+    if (nodes.empty()) { return false; }
+
+    float best = max_distance < FLT_MAX ? max_distance * max_distance : FLT_MAX;
+    int best_tri = -1;
+
+    int stack[BVHMaxStack];
+    int sp = 0;
+    stack[sp++] = 0;
+
+    while (sp > 0) {
+        auto& node = nodes[stack[--sp]];
+        if (space.distanceSq(pos, node) > best) { continue; }
+
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; ++i) {
+                float3 p1 = space.point({ soa[0][i], soa[1][i], soa[2][i] });
+                float3 p2 = space.point({ soa[3][i], soa[4][i], soa[5][i] });
+                float3 p3 = space.point({ soa[6][i], soa[7][i], soa[8][i] });
+                float u, v;
+                float3 d = closest_point_on_triangle(pos, p1, p2, p3, u, v) - pos;
+                float dsq = dot(d, d);
+                int ti = bvh.tri_indices[i];
+                // pick smaller index on tie to get the same result regardless of the tree
+                if (dsq < best || (dsq == best && best_tri != -1 && ti < hit.tindex)) {
+                    best = dsq;
+                    best_tri = i;
+                    hit.tindex = ti;
+                    hit.u = u;
+                    hit.v = v;
+                }
+            }
+        }
+        else {
+            // visit nearer child first
+            int l = node.first, r = node.first + 1;
+            float dl = space.distanceSq(pos, nodes[l]);
+            float dr = space.distanceSq(pos, nodes[r]);
+            if (dl <= dr) {
+                if (dr <= best) { stack[sp++] = r; }
+                if (dl <= best) { stack[sp++] = l; }
+            }
+            else {
+                if (dl <= best) { stack[sp++] = l; }
+                if (dr <= best) { stack[sp++] = r; }
+            }
+        }
+    }
+
+    if (best_tri == -1) { return false; }
+    hit.distance = std::sqrt(best);
+    return true;
+}
+
+bool TriangleBVH::closestPoint(float3 pos, float max_distance, Hit& hit) const
+{
+    return ClosestPointImpl(*this, BVHIdentitySpace(), pos, max_distance, hit);
+}
+
+bool TriangleBVH::closestPoint(float3 pos, const float4x4& transform, float max_distance, Hit& hit) const
+{
+    return ClosestPointImpl(*this, BVHTransformedSpace{ transform }, pos, max_distance, hit);
+}
+
+void TriangleBVH::closestPoint(const float3 *pos, int num_points, float max_distance, Hit *hits) const
+{
+    parallel_for_blocked(0, num_points, PacketSize * 16, [&](int i, int iend) {
+        for (; i < iend; ++i) {
+            closestPoint(pos[i], max_distance, hits[i]);
+        }
+    });
+}
+
+void TriangleBVH::closestPoint(const float3 *pos, int num_points, const float4x4& transform, float max_distance, Hit *hits) const
+{
+    parallel_for_blocked(0, num_points, PacketSize * 16, [&](int i, int iend) {
+        for (; i < iend; ++i) {
+            closestPoint(pos[i], transform, max_distance, hits[i]);
+        }
+    });
+}
+
+void TriangleBVH::gatherSwept(float3 pos, float radius, float3 dir, RawVector<int>& dst) const
+{
+    dst.clear();
+    if (nodes.empty()) { return; }
+
+    // node bounds expanded by radius contain the node swept by the sphere. test them with the ray from the center.
+    float3 idir = safe_inv_dir(dir);
+    int stack[BVHMaxStack];
+    int sp = 0;
+    stack[sp++] = 0;
+
+    while (sp > 0) {
+        auto& node = nodes[stack[--sp]];
+        float tnear;
+        if (!RayAABB(pos, idir, node.bb_min - radius, node.bb_max + radius, FLT_MAX, tnear)) { continue; }
+
+        if (node.count > 0) {
+            for (int i = 0; i < node.count; ++i) {
+                dst.push_back(tri_indices[node.first + i]);
+            }
+        }
+        else {
+            stack[sp++] = node.first + 1;
+            stack[sp++] = node.first;
+        }
+    }
+    std::sort(dst.begin(), dst.end());
+}
+
+void TriangleBVH::raycast(const float3 *pos, const float3 *dir, int num_rays, Hit *hits) const
+{
+    if (nodes.empty()) {
+        for (int i = 0; i < num_rays; ++i) { hits[i].tindex = -1; }
+        return;
+    }
+    int num_packets = ceildiv(num_rays, PacketSize);
+    parallel_for(0, num_packets, [&](int pi) {
+        int first = pi * PacketSize;
+        int n = std::min(PacketSize, num_rays - first);
+        raycastPacket(pos + first, dir + first, n, hits + first);
+    });
+}
+
+void TriangleBVH::occluded(const float3 *pos, const float3 *dir, const float *max_distances, const int *ignore_vertices, int num_rays,
+    const int *indices, bool *result) const
+{
+    if (nodes.empty()) {
+        for (int i = 0; i < num_rays; ++i) { result[i] = false; }
+        return;
+    }
+    int num_packets = ceildiv(num_rays, PacketSize);
+    parallel_for(0, num_packets, [&](int pi) {
+        int first = pi * PacketSize;
+        int n = std::min(PacketSize, num_rays - first);
+        occludedPacket(pos + first, dir + first, max_distances + first, ignore_vertices + first, n, indices, result + first);
+    });
+}
+
+// rays of a packet in SoA layout. lanes are processed by fixed length loops without branches so that they are vectorized.
+// unused lanes are filled with copies of the first ray and masked out.
+struct alignas(32) RayPacket
+{
+    static const int Size = TriangleBVH::PacketSize;
+    float px[Size], py[Size], pz[Size];
+    float dx[Size], dy[Size], dz[Size];
+    float ix[Size], iy[Size], iz[Size];
+
+    void set(const float3 *pos, const float3 *dir, int num_rays)
+    {
+        for (int l = 0; l < Size; ++l) {
+            int r = l < num_rays ? l : 0;
+            float3 idir = safe_inv_dir(dir[r]);
+            px[l] = pos[r].x; py[l] = pos[r].y; pz[l] = pos[r].z;
+            dx[l] = dir[r].x; dy[l] = dir[r].y; dz[l] = dir[r].z;
+            ix[l] = idir.x; iy[l] = idir.y; iz[l] = idir.z;
+        }
+    }
+
+    // slab test of all lanes. same as RayAABB() per lane. returns the mask of lanes that hit.
+    int intersectAABB(const float3& bmin, const float3& bmax, const float *tmax, float *tnear) const
+    {
+        int hit[Size];
+        for (int l = 0; l < Size; ++l) {
+            float t1x = (bmin.x - px[l]) * ix[l], t2x = (bmax.x - px[l]) * ix[l];
+            float t1y = (bmin.y - py[l]) * iy[l], t2y = (bmax.y - py[l]) * iy[l];
+            float t1z = (bmin.z - pz[l]) * iz[l], t2z = (bmax.z - pz[l]) * iz[l];
+            float n = std::max(std::max(std::min(t1x, t2x), std::min(t1y, t2y)), std::min(t1z, t2z));
+            float f = std::min(std::min(std::max(t1x, t2x), std::max(t1y, t2y)), std::max(t1z, t2z));
+            tnear[l] = n;
+            hit[l] = (n <= f) & (f >= 0.0f) & (n <= tmax[l]);
+        }
+        int mask = 0;
+        for (int l = 0; l < Size; ++l) { mask |= hit[l] << l; }
+        return mask;
+    }
+
+    // ray_triangle_intersection() of all lanes with the same operations. returns the mask of lanes that hit.
+    int intersectTriangle(const float3& p1, const float3& p2, const float3& p3, float *distance, float *u, float *v) const
+    {
+        const float epsdet = 1e-10f;
+        const float eps = 1e-4f;
+        float3 e1 = p2 - p1;
+        float3 e2 = p3 - p1;
+
+        int hit[Size];
+        for (int l = 0; l < Size; ++l) {
+            // p = cross(dir, e2)
+            float qpx = dy[l] * e2.z - dz[l] * e2.y;
+            float qpy = dz[l] * e2.x - dx[l] * e2.z;
+            float qpz = dx[l] * e2.y - dy[l] * e2.x;
+            float det = e1.x * qpx + e1.y * qpy + e1.z * qpz;
+            float inv_det = 1.0f / det;
+            float tx = px[l] - p1.x, ty = py[l] - p1.y, tz = pz[l] - p1.z;
+            float uu = (tx * qpx + ty * qpy + tz * qpz) * inv_det;
+            // q = cross(t, e1)
+            float qx = ty * e1.z - tz * e1.y;
+            float qy = tz * e1.x - tx * e1.z;
+            float qz = tx * e1.y - ty * e1.x;
+            float vv = (dx[l] * qx + dy[l] * qy + dz[l] * qz) * inv_det;
+            float d = (e2.x * qx + e2.y * qy + e2.z * qz) * inv_det;
+            u[l] = uu;
+            v[l] = vv;
+            distance[l] = d;
+            int miss = (std::abs(det) < epsdet) | (uu < -eps) | (uu > 1 + eps) | (vv < -eps) | (uu + vv > 1 + eps);
+            hit[l] = (miss ^ 1) & (d >= 0.0f);
+        }
+        int mask = 0;
+        for (int l = 0; l < Size; ++l) { mask |= hit[l] << l; }
+        return mask;
+    }
+};
+
+void TriangleBVH::raycastPacket(const float3 *pos, const float3 *dir, int num_rays, Hit *hits) const
+{
+    RayPacket rays;
+    rays.set(pos, dir, num_rays);
+    float best[PacketSize];
+    for (int l = 0; l < PacketSize; ++l) { best[l] = FLT_MAX; }
+    for (int r = 0; r < num_rays; ++r) { hits[r].tindex = -1; }
+
+    // each entry holds the rays that hit the node and their entry distances
+    struct Entry { int node, rays; float tnear[PacketSize]; };
+    Entry stack[BVHMaxStack];
+    int sp = 0;
+
+    auto& root = stack[sp];
+    root.node = 0;
+    root.rays = rays.intersectAABB(nodes[0].bb_min, nodes[0].bb_max, best, root.tnear) & ((1 << num_rays) - 1);
+    if (root.rays != 0) { ++sp; }
+
+    float d[PacketSize], u[PacketSize], v[PacketSize];
+    while (sp > 0) {
+        auto& e = stack[--sp];
+        // drop rays that have found a closer hit since the node was pushed
+        int active = e.rays;
+        for (int l = 0; l < PacketSize; ++l) {
+            if (e.tnear[l] > best[l]) { active &= ~(1 << l); }
+        }
+        if (active == 0) { continue; }
+
+        auto& node = nodes[e.node];
+        if (node.count > 0) {
+            int end = node.first + node.count;
+            for (int i = node.first; i < end; ++i) {
+                int mask = active & rays.intersectTriangle(
+                    { soa[0][i], soa[1][i], soa[2][i] },
+                    { soa[3][i], soa[4][i], soa[5][i] },
+                    { soa[6][i], soa[7][i], soa[8][i] }, d, u, v);
+                if (mask == 0) { continue; }
+
+                int ti = tri_indices[i];
+                for (int r = 0; r < num_rays; ++r) {
+                    if ((mask & (1 << r)) == 0) { continue; }
+                    auto& hit = hits[r];
+                    // on tie, pick smaller triangle index to match brute force
+                    if (d[r] < best[r] || (d[r] == best[r] && ti < hit.tindex)) {
+                        best[r] = d[r];
+                        hit.tindex = ti;
+                        hit.distance = d[r];
+                        hit.u = u[r];
+                        hit.v = v[r];
+                    }
+                }
+            }
+        }
+        else {
+            int l = node.first, r = node.first + 1;
+            Entry el, er;
+            el.node = l;
+            er.node = r;
+            el.rays = active & rays.intersectAABB(nodes[l].bb_min, nodes[l].bb_max, best, el.tnear);
+            er.rays = active & rays.intersectAABB(nodes[r].bb_min, nodes[r].bb_max, best, er.tnear);
+
+            // visit first the child that is nearer for the majority of rays that hit both
+            int both = el.rays & er.rays, num_both = 0, left_first = 0;
+            for (int k = 0; k < PacketSize; ++k) {
+                if (both & (1 << k)) {
+                    ++num_both;
+                    if (el.tnear[k] <= er.tnear[k]) { ++left_first; }
+                }
+            }
+            bool push_left_last = left_first * 2 >= num_both;
+            auto& first = push_left_last ? er : el;
+            auto& last = push_left_last ? el : er;
+            if (first.rays) { stack[sp++] = first; }
+            if (last.rays) { stack[sp++] = last; }
+        }
+    }
+}
+
+void TriangleBVH::occludedPacket(const float3 *pos, const float3 *dir, const float *max_distances, const int *ignore_vertices, int num_rays,
+    const int *indices, bool *result) const
+{
+    RayPacket rays;
+    rays.set(pos, dir, num_rays);
+    float tmax[PacketSize];
+    int ignore[PacketSize];
+    for (int l = 0; l < PacketSize; ++l) {
+        int r = l < num_rays ? l : 0;
+        tmax[l] = max_distances[r];
+        ignore[l] = ignore_vertices[r];
+    }
+    for (int r = 0; r < num_rays; ++r) { result[r] = false; }
+    int remaining = (1 << num_rays) - 1;
+
+    struct Entry { int node, rays; };
+    Entry stack[BVHMaxStack];
+    int sp = 0;
+    stack[sp++] = { 0, remaining };
+
+    float tnear[PacketSize], d[PacketSize], u[PacketSize], v[PacketSize];
+    while (sp > 0 && remaining != 0) {
+        auto e = stack[--sp];
+        auto& node = nodes[e.node];
+
+        int active = e.rays & remaining & rays.intersectAABB(node.bb_min, node.bb_max, tmax, tnear);
+        if (active == 0) { continue; }
+
+        if (node.count > 0) {
+            int end = node.first + node.count;
+            for (int i = node.first; i < end && active != 0; ++i) {
+                int mask = active & rays.intersectTriangle(
+                    { soa[0][i], soa[1][i], soa[2][i] },
+                    { soa[3][i], soa[4][i], soa[5][i] },
+                    { soa[6][i], soa[7][i], soa[8][i] }, d, u, v);
+                if (mask == 0) { continue; }
+
+                const int *tri = &indices[tri_indices[i] * 3];
+                for (int r = 0; r < num_rays; ++r) {
+                    if ((mask & (1 << r)) == 0) { continue; }
+                    int iv = ignore[r];
+                    if (tri[0] == iv || tri[1] == iv || tri[2] == iv || !(d[r] < tmax[r])) { continue; }
+                    result[r] = true;
+                    active &= ~(1 << r);
+                    remaining &= ~(1 << r);
+                }
+            }
+        }
+        else {
+            stack[sp++] = { node.first + 1, active };
+            stack[sp++] = { node.first, active };
+        }
+    }
+}
+
+
+// interleaves lower 10 bits of x, y and z
+static inline uint32_t MortonCode(uint32_t x, uint32_t y, uint32_t z)
+{
+    auto spread = [](uint32_t v) {
+        v &= 0x3ff;
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v << 8)) & 0x0300f00f;
+        v = (v | (v << 4)) & 0x030c30c3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+}
+
+void TriangleClusters::clear()
+{
+    tri_indices.clear();
+    for (auto& a : soa) { a.clear(); }
+    bb_min.clear();
+    bb_max.clear();
+    offsets.clear();
+}
+
+bool TriangleClusters::empty() const
+{
+    return tri_indices.empty();
+}
+
+int TriangleClusters::numClusters() const
+{
+    return (int)bb_min.size();
+}
+
+void TriangleClusters::build(const IArray<int>& indices, const IArray<float3>& vertices, int cluster_size)
+{
+    clear();
+    int num_triangles = (int)indices.size() / 3;
+    if (num_triangles == 0) { return; }
+
+    RawVector<float3> centers;
+    centers.resize_discard(num_triangles);
+    float3 cmin = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float3 cmax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (int ti = 0; ti < num_triangles; ++ti) {
+        auto c = (vertices[indices[ti * 3 + 0]] + vertices[indices[ti * 3 + 1]] + vertices[indices[ti * 3 + 2]]) / 3.0f;
+        centers[ti] = c;
+        cmin = min3(cmin, c);
+        cmax = max3(cmax, c);
+    }
+
+    // sort triangles by morton code of the center so that each cluster is spatially compact.
+    // ties are resolved by triangle index to keep the order deterministic.
+    float3 extent = cmax - cmin;
+    float3 scale = {
+        extent.x > 0.0f ? 1023.0f / extent.x : 0.0f,
+        extent.y > 0.0f ? 1023.0f / extent.y : 0.0f,
+        extent.z > 0.0f ? 1023.0f / extent.z : 0.0f,
+    };
+    RawVector<uint64_t> keys;
+    keys.resize_discard(num_triangles);
+    parallel_for_blocked(0, num_triangles, 1024, [&](int ti, int tend) {
+        for (; ti < tend; ++ti) {
+            float3 q = (centers[ti] - cmin) * scale;
+            uint64_t code = MortonCode((uint32_t)q.x, (uint32_t)q.y, (uint32_t)q.z);
+            keys[ti] = (code << 32) | (uint32_t)ti;
+        }
+    });
+    std::sort(keys.begin(), keys.end());
+
+    tri_indices.resize_discard(num_triangles);
+    for (int ti = 0; ti < num_triangles; ++ti) {
+        tri_indices[ti] = (int)(keys[ti] & 0xffffffff);
+    }
+
+    int num_clusters = (num_triangles + cluster_size - 1) / cluster_size;
+    offsets.resize_discard(num_clusters + 1);
+    for (int ci = 0; ci < num_clusters; ++ci) {
+        offsets[ci] = ci * cluster_size;
+    }
+    offsets[num_clusters] = num_triangles;
+
+    refit(indices, vertices);
+}
+
+void TriangleClusters::refit(const IArray<int>& indices, const IArray<float3>& vertices)
+{
+    if (tri_indices.empty()) { return; }
+    GatherTriangles(soa, tri_indices, indices, vertices);
+
+    int num_clusters = (int)offsets.size() - 1;
+    bb_min.resize_discard(num_clusters);
+    bb_max.resize_discard(num_clusters);
+    parallel_for(0, num_clusters, [&](int ci) {
+        float3 bmin, bmax;
+        GetTriangleBounds(soa, offsets[ci], bb_min[ci], bb_max[ci]);
+        for (int i = offsets[ci] + 1; i < offsets[ci + 1]; ++i) {
+            GetTriangleBounds(soa, i, bmin, bmax);
+            bb_min[ci] = min3(bb_min[ci], bmin);
+            bb_max[ci] = max3(bb_max[ci], bmax);
+        }
+    });
+}
+
+bool TriangleClusters::raycast(float3 pos, float3 dir, int& tindex, float& distance) const
+{
+    if (tri_indices.empty()) { return false; }
+
+    int ti;
+    float d;
+    if (RayTrianglesIntersectionClustered(pos, dir,
+        soa[0].data(), soa[1].data(), soa[2].data(),
+        soa[3].data(), soa[4].data(), soa[5].data(),
+        soa[6].data(), soa[7].data(), soa[8].data(),
+        bb_min.data(), bb_max.data(), offsets.data(), numClusters(), ti, d) > 0)
+    {
+        tindex = tri_indices[ti];
+        distance = d;
+        return true;
+    }
+    return false;
+}
+
+
+void SceneBVH::clear()
+{
+    blas.clear();
+    transforms.clear();
+    itransforms.clear();
+    nodes.clear();
+}
+
+bool SceneBVH::empty() const
+{
+    return nodes.empty();
+}
+
+void SceneBVH::getInstanceBounds(int i, float3& bmin, float3& bmax) const
+{
+    bmin = { FLT_MAX, FLT_MAX, FLT_MAX };
+    bmax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    if (!blas[i] || blas[i]->empty()) { return; }
+
+    // transform corners of the root bounds
+    auto& root = blas[i]->nodes[0];
+    for (int c = 0; c < 8; ++c) {
+        float3 p = {
+            (c & 1) ? root.bb_max.x : root.bb_min.x,
+            (c & 2) ? root.bb_max.y : root.bb_min.y,
+            (c & 4) ? root.bb_max.z : root.bb_min.z,
+        };
+        p = mul_p(transforms[i], p);
+        bmin = min3(bmin, p);
+        bmax = max3(bmax, p);
+    }
+}
+
+void SceneBVH::updateBounds()
+{
+    // same as TriangleBVH::updateBounds(). children are placed after their parent.
+    for (int ni = (int)nodes.size() - 1; ni >= 0; --ni) {
+        auto& node = nodes[ni];
+        if (node.count > 0) {
+            getInstanceBounds(node.first, node.bb_min, node.bb_max);
+        }
+        else {
+            auto& l = nodes[node.first];
+            auto& r = nodes[node.first + 1];
+            node.bb_min = min3(l.bb_min, r.bb_min);
+            node.bb_max = max3(l.bb_max, r.bb_max);
+        }
+    }
+}
+
+void SceneBVH::build(const TriangleBVH * const *blas_, const float4x4 *transforms_, int num_instances)
+{
+    clear();
+    if (num_instances == 0) { return; }
+
+    blas.assign(blas_, blas_ + num_instances);
+    transforms.assign(transforms_, transforms_ + num_instances);
+    itransforms.resize_discard(num_instances);
+    for (int i = 0; i < num_instances; ++i) {
+        itransforms[i] = invert(transforms[i]);
+    }
+
+    // instances are few. split at the median of the longest axis of bounds centers until each leaf has one instance.
+    RawVector<int> order;
+    RawVector<float3> centers;
+    order.resize_discard(num_instances);
+    centers.resize_discard(num_instances);
+    for (int i = 0; i < num_instances; ++i) {
+        float3 bmin, bmax;
+        getInstanceBounds(i, bmin, bmax);
+        order[i] = i;
+        centers[i] = bmin.x <= bmax.x ? (bmin + bmax) * 0.5f : mul_p(transforms[i], float3::zero());
+    }
+
+    nodes.reserve(num_instances * 2);
+    nodes.push_back({ float3::zero(), 0, float3::zero(), num_instances });
+    struct Task { int node, first, count; };
+    RawVector<Task> tasks;
+    tasks.push_back({ 0, 0, num_instances });
+    while (!tasks.empty()) {
+        auto t = tasks.back();
+        tasks.pop_back();
+        if (t.count == 1) {
+            nodes[t.node].first = order[t.first];
+            nodes[t.node].count = 1;
+            continue;
+        }
+
+        float3 cmin = centers[order[t.first]], cmax = cmin;
+        for (int i = t.first + 1; i < t.first + t.count; ++i) {
+            cmin = min3(cmin, centers[order[i]]);
+            cmax = max3(cmax, centers[order[i]]);
+        }
+        float3 e = cmax - cmin;
+        int axis = e.x >= e.y && e.x >= e.z ? 0 : (e.y >= e.z ? 1 : 2);
+
+        int mid = t.count / 2;
+        std::nth_element(order.begin() + t.first, order.begin() + t.first + mid, order.begin() + t.first + t.count,
+            [&](int a, int b) { return centers[a][axis] < centers[b][axis] || (centers[a][axis] == centers[b][axis] && a < b); });
+
+        int left = (int)nodes.size();
+        nodes.push_back({ float3::zero(), 0, float3::zero(), 0 });
+        nodes.push_back({ float3::zero(), 0, float3::zero(), 0 });
+        nodes[t.node].first = left;
+        nodes[t.node].count = 0;
+        tasks.push_back({ left, t.first, mid });
+        tasks.push_back({ left + 1, t.first + mid, t.count - mid });
+    }
+
+    updateBounds();
+}
+
+void SceneBVH::refit(const float4x4 *transforms_)
+{
+    if (nodes.empty()) { return; }
+
+    int num_instances = (int)blas.size();
+    transforms.assign(transforms_, transforms_ + num_instances);
+    for (int i = 0; i < num_instances; ++i) {
+        itransforms[i] = invert(transforms[i]);
+    }
+    updateBounds();
+}
+
+bool SceneBVH::raycast(float3 pos, float3 dir, Hit& hit) const
+{
+    hit.instance = -1;
+    if (nodes.empty()) { return false; }
+
+    float3 idir = safe_inv_dir(dir);
+    float best = FLT_MAX;
+
+    struct Entry { int node; float tnear; };
+    Entry stack[BVHMaxStack];
+    int sp = 0;
+
+    float tnear;
+    if (!RayAABB(pos, idir, nodes[0].bb_min, nodes[0].bb_max, best, tnear)) { return false; }
+    stack[sp++] = { 0, tnear };
+
+    while (sp > 0) {
+        auto e = stack[--sp];
+        if (e.tnear > best) { continue; }
+
+        auto& node = nodes[e.node];
+        if (node.count > 0) {
+            // trace the bottom-level BVH in the instance's local space.
+            // local distance / length of the local direction = world distance.
+            int ii = node.first;
+            float3 ldir = mul_v(itransforms[ii], dir);
+            float len = length(ldir);
+            if (len == 0.0f) { continue; }
+
+            int ti;
+            float d;
+            if (blas[ii]->raycast(mul_p(itransforms[ii], pos), ldir / len, ti, d)) {
+                d /= len;
+                if (d < best || (d == best && ii < hit.instance)) {
+                    best = d;
+                    hit.instance = ii;
+                    hit.tindex = ti;
+                    hit.distance = d;
+                }
+            }
+        }
+        else {
+            int l = node.first, r = node.first + 1;
+            float tl, tr;
+            bool hl = RayAABB(pos, idir, nodes[l].bb_min, nodes[l].bb_max, best, tl);
+            bool hr = RayAABB(pos, idir, nodes[r].bb_min, nodes[r].bb_max, best, tr);
+            if (hl && hr) {
+                if (tl <= tr) {
+                    stack[sp++] = { r, tr };
+                    stack[sp++] = { l, tl };
+                }
+                else {
+                    stack[sp++] = { l, tl };
+                    stack[sp++] = { r, tr };
+                }
+            }
+            else if (hl) { stack[sp++] = { l, tl }; }
+            else if (hr) { stack[sp++] = { r, tr }; }
+        }
+    }
+    return hit.instance != -1;
+}
+
+} // namespace mu
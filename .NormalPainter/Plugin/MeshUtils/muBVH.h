@@ -0,0 +1,124 @@
+#pragma once
+
+namespace mu {
+
+// bounding volume hierarchy of triangles (binned SAH).
+// triangle positions are copied into SoA arrays in node order, so a leaf is a contiguous range of triangles.
+// call refit() when vertices are moved but topology is unchanged.
+struct TriangleBVH
+{
+    struct Node
+    {
+        float3 bb_min;
+        int first; // leaf: first triangle (node order). inner: index of left child (right child is first + 1)
+        float3 bb_max;
+        int count; // number of triangles if leaf. 0 if inner
+    };
+
+    struct Hit
+    {
+        int tindex;     // original triangle index. -1 if no hit
+        float distance;
+        float u, v;     // barycentric coordinates of p2 and p3 at the hit position
+    };
+
+    // batched queries trace PacketSize consecutive rays together: each node and triangle is tested against all rays
+    // of the packet at once (SoA lanes). keep coherent rays adjacent.
+    static const int PacketSize = 8;
+
+    RawVector<Node> nodes;
+    RawVector<int> tri_indices; // node order -> original triangle index
+    RawVector<float> soa[9];    // triangle positions (p1.xyz, p2.xyz, p3.xyz) in node order
+
+    void clear();
+    bool empty() const;
+    int numTriangles() const;
+
+    void build(const IArray<int>& indices, const IArray<float3>& vertices);
+    void refit(const IArray<int>& indices, const IArray<float3>& vertices);
+
+    // closest hit. returns same result as RayTrianglesIntersectionIndexed() (tindex is the original triangle index)
+    bool raycast(float3 pos, float3 dir, int& tindex, float& distance) const;
+    // any-hit within [0, max_distance). same as RayTrianglesOcclusionIndexed() (indices must be the ones used to build)
+    bool occluded(float3 pos, float3 dir, float max_distance, const int *indices, int ignore_vertex) const;
+
+    // nearest point on triangles within max_distance. hit.u and hit.v are barycentric coordinates of the point.
+    // returns false if no triangles are within max_distance.
+    bool closestPoint(float3 pos, float max_distance, Hit& hit) const;
+    // same as above with triangles transformed by transform (any affine transform). pos and distances are in that space.
+    // no rebuild is needed for non-uniform scale or shear, which change which point is the nearest.
+    bool closestPoint(float3 pos, const float4x4& transform, float max_distance, Hit& hit) const;
+
+    // gathers triangles (original indices, ascending order) that may be hit by rays of direction dir
+    // starting from inside of the sphere (pos, radius). i.e. triangles that intersect the sphere swept along dir.
+    void gatherSwept(float3 pos, float radius, float3 dir, RawVector<int>& dst) const;
+
+    // batched variants of raycast() and occluded(). rays are processed in parallel.
+    void raycast(const float3 *pos, const float3 *dir, int num_rays, Hit *hits) const;
+    void occluded(const float3 *pos, const float3 *dir, const float *max_distances, const int *ignore_vertices, int num_rays,
+        const int *indices, bool *result) const;
+    void closestPoint(const float3 *pos, int num_points, float max_distance, Hit *hits) const;
+    void closestPoint(const float3 *pos, int num_points, const float4x4& transform, float max_distance, Hit *hits) const;
+
+private:
+    void updateTriangles(const IArray<int>& indices, const IArray<float3>& vertices);
+    void updateBounds();
+    void getTriangleBounds(int i, float3& bmin, float3& bmax) const;
+    void raycastPacket(const float3 *pos, const float3 *dir, int num_rays, Hit *hits) const;
+    void occludedPacket(const float3 *pos, const float3 *dir, const float *max_distances, const int *ignore_vertices, int num_rays,
+        const int *indices, bool *result) const;
+};
+
+// lightweight alternative to TriangleBVH for moderate numbers of rays: triangles are sorted along a morton curve
+// and grouped into fixed size clusters with bounds. cheaper to build than TriangleBVH, but every cluster is slab-tested per ray.
+struct TriangleClusters
+{
+    static const int DefaultClusterSize = 64;
+
+    RawVector<int> tri_indices; // clustered order -> original triangle index
+    RawVector<float> soa[9];    // triangle positions (p1.xyz, p2.xyz, p3.xyz) in clustered order
+    RawVector<float3> bb_min, bb_max;
+    RawVector<int> offsets;     // triangles of cluster i are [offsets[i], offsets[i + 1])
+
+    void clear();
+    bool empty() const;
+    int numClusters() const;
+
+    void build(const IArray<int>& indices, const IArray<float3>& vertices, int cluster_size = DefaultClusterSize);
+    void refit(const IArray<int>& indices, const IArray<float3>& vertices);
+
+    // closest hit. tindex is the original triangle index.
+    // on exact ties of distance the triangle that comes first in clustered order wins.
+    bool raycast(float3 pos, float3 dir, int& tindex, float& distance) const;
+};
+
+// two-level acceleration structure: a BVH over world space bounds of instances, each of which is a TriangleBVH with a transform.
+// bottom-level BVHs are referenced, not owned. call refit() when only transforms (or vertices of bottom-level BVHs) are changed.
+struct SceneBVH
+{
+    struct Hit
+    {
+        int instance;   // -1 if no hit
+        int tindex;     // original triangle index of the instance's mesh
+        float distance; // world space
+    };
+
+    RawVector<const TriangleBVH*> blas;
+    RawVector<float4x4> transforms, itransforms;
+    RawVector<TriangleBVH::Node> nodes; // leaf: first is the instance index and count is 1
+
+    void clear();
+    bool empty() const;
+
+    void build(const TriangleBVH * const *blas, const float4x4 *transforms, int num_instances);
+    void refit(const float4x4 *transforms);
+
+    // closest hit among all instances. dir must be normalized. on exact ties the smaller instance index wins.
+    bool raycast(float3 pos, float3 dir, Hit& hit) const;
+
+private:
+    void updateBounds();
+    void getInstanceBounds(int i, float3& bmin, float3& bmax) const;
+};
+
+} // namespace mu
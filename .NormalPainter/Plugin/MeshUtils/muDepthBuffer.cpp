@@ -0,0 +1,268 @@
+#include "pch.h"
+#include "MeshUtils.h"
+
+namespace mu {
+
+static const float DepthBufferNearW = 1e-3f;
+
+struct TileRange { int x0, y0, x1, y1; }; // inclusive. x0 > x1 if empty
+
+void DepthBuffer::clear()
+{
+    width = height = 0;
+    tiles_x = tiles_y = 0;
+    depth.clear();
+    tindices.clear();
+    tile_offsets.clear();
+    tile_triangles.clear();
+    near_w.clear();
+    near_triangles.clear();
+}
+
+bool DepthBuffer::empty() const
+{
+    return tindices.empty();
+}
+
+void DepthBuffer::build(const float4x4& mvp_, float3 eye, const IArray<int>& indices, const IArray<float3>& vertices, int width_, int height_)
+{
+    mvp = mvp_;
+    width = width_;
+    height = height_;
+    tiles_x = (width + TileSize - 1) / TileSize;
+    tiles_y = (height + TileSize - 1) / TileSize;
+
+    int num_vertices = (int)vertices.size();
+    int num_triangles = (int)indices.size() / 3;
+
+    RawVector<float4> clip;
+    clip.resize_discard(num_vertices);
+    parallel_for_blocked(0, num_vertices, 1024, [&](int vi, int vend) {
+        for (; vi < vend; ++vi) {
+            clip[vi] = mul4(mvp, vertices[vi]);
+        }
+    });
+
+    // direction of depth: compare a vertex with a point further along the line of sight
+    depth_sign = 1.0f;
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        float3 d = vertices[vi] - eye;
+        if (clip[vi].w <= DepthBufferNearW || length_sq(d) == 0.0f) { continue; }
+        float4 far = mul4(mvp, vertices[vi] + d);
+        if (far.w <= DepthBufferNearW) { continue; }
+        float z1 = clip[vi].z / clip[vi].w;
+        float z2 = far.z / far.w;
+        if (z1 != z2) {
+            depth_sign = z2 > z1 ? 1.0f : -1.0f;
+            break;
+        }
+    }
+
+    auto to_screen = [&](const float4& c) -> float3 {
+        float iw = 1.0f / c.w;
+        return{ (c.x * iw * 0.5f + 0.5f) * width, (c.y * iw * 0.5f + 0.5f) * height, c.z * iw * depth_sign };
+    };
+
+    // clip triangles by the near plane and convert to screen space. a triangle becomes a polygon of up to 4 vertices.
+    // tiles: range of tiles covered by the bounds of the polygon.
+    RawVector<float3> polygons;
+    RawVector<int> counts;
+    RawVector<TileRange> tiles;
+    RawVector<char> crossing;
+    polygons.resize_discard(num_triangles * 4);
+    counts.resize_discard(num_triangles);
+    tiles.resize_discard(num_triangles);
+    crossing.resize_discard(num_triangles);
+    near_w.resize_discard(num_triangles);
+    parallel_for_blocked(0, num_triangles, 1024, [&](int ti, int tend) {
+        for (; ti < tend; ++ti) {
+            float4 c[3] = { clip[indices[ti * 3 + 0]], clip[indices[ti * 3 + 1]], clip[indices[ti * 3 + 2]] };
+            float3 *poly = &polygons[ti * 4];
+            int n = 0, num_in = 0;
+            float nw = FLT_MAX;
+            for (int i = 0; i < 3; ++i) {
+                const float4& a = c[i];
+                const float4& b = c[(i + 1) % 3];
+                bool ain = a.w > DepthBufferNearW;
+                bool bin = b.w > DepthBufferNearW;
+                if (ain) {
+                    poly[n++] = to_screen(a);
+                    nw = std::min(nw, a.w);
+                    ++num_in;
+                }
+                if (ain != bin) {
+                    float t = (DepthBufferNearW - a.w) / (b.w - a.w);
+                    poly[n++] = to_screen(a + (b - a) * t);
+                    nw = DepthBufferNearW;
+                }
+            }
+            counts[ti] = n;
+            near_w[ti] = nw;
+            // also triangles between the eye and the near plane, which may block rays but are not rasterized
+            crossing[ti] = num_in < 3 && std::max(std::max(c[0].w, c[1].w), c[2].w) > 0.0f;
+
+            float3 bmin = poly[0], bmax = poly[0];
+            for (int i = 1; i < n; ++i) {
+                bmin = min(bmin, poly[i]);
+                bmax = max(bmax, poly[i]);
+            }
+            // the margin covers rounding of projections and the tolerance of ray-triangle tests
+            auto& tr = tiles[ti];
+            if (n == 0 || !std::isfinite(bmin.x) || !std::isfinite(bmin.y) || !std::isfinite(bmax.x) || !std::isfinite(bmax.y) ||
+                bmax.x < -1.0f || bmax.y < -1.0f || bmin.x > width + 1.0f || bmin.y > height + 1.0f)
+            {
+                tr = { 0, 0, -1, -1 };
+                continue;
+            }
+            // clamped before casting as bounds of triangles near the near plane can be huge
+            tr.x0 = (int)clamp((bmin.x - 1.0f) / TileSize, 0.0f, (float)(tiles_x - 1));
+            tr.y0 = (int)clamp((bmin.y - 1.0f) / TileSize, 0.0f, (float)(tiles_y - 1));
+            tr.x1 = (int)clamp((bmax.x + 1.0f) / TileSize, 0.0f, (float)(tiles_x - 1));
+            tr.y1 = (int)clamp((bmax.y + 1.0f) / TileSize, 0.0f, (float)(tiles_y - 1));
+        }
+    });
+
+    near_triangles.clear();
+    for (int ti = 0; ti < num_triangles; ++ti) {
+        if (crossing[ti]) { near_triangles.push_back(ti); }
+    }
+
+    // bin triangles into rows of tiles by their screen space y range. triangles are in index order in each row.
+    RawVector<int> row_offsets, row_triangles;
+    row_offsets.resize_zeroclear(tiles_y + 1);
+    for (int ti = 0; ti < num_triangles; ++ti) {
+        auto& tr = tiles[ti];
+        for (int ty = tr.y0; ty <= tr.y1 && tr.x0 <= tr.x1; ++ty) { ++row_offsets[ty + 1]; }
+    }
+    for (int ty = 0; ty < tiles_y; ++ty) { row_offsets[ty + 1] += row_offsets[ty]; }
+    row_triangles.resize_discard(row_offsets.back());
+    {
+        RawVector<int> pos;
+        pos.assign(row_offsets.begin(), row_offsets.end() - 1);
+        for (int ti = 0; ti < num_triangles; ++ti) {
+            auto& tr = tiles[ti];
+            for (int ty = tr.y0; ty <= tr.y1 && tr.x0 <= tr.x1; ++ty) { row_triangles[pos[ty]++] = ti; }
+        }
+    }
+
+    // number of (tile, triangle) pairs of each row, to place tiles of rows in tile_triangles
+    RawVector<int> row_bases;
+    row_bases.resize_zeroclear(tiles_y + 1);
+    parallel_for(0, tiles_y, [&](int ty) {
+        int n = 0;
+        for (int i = row_offsets[ty]; i < row_offsets[ty + 1]; ++i) {
+            auto& tr = tiles[row_triangles[i]];
+            n += tr.x1 - tr.x0 + 1;
+        }
+        row_bases[ty + 1] = n;
+    });
+    for (int ty = 0; ty < tiles_y; ++ty) { row_bases[ty + 1] += row_bases[ty]; }
+
+    depth.resize_discard(width * height);
+    tindices.resize_discard(width * height);
+    tile_offsets.resize_discard(tiles_x * tiles_y + 1);
+    tile_offsets.back() = row_bases.back();
+    tile_triangles.resize_discard(row_bases.back());
+
+    // each row of tiles is rasterized and binned in parallel. triangles are processed in index order in each row,
+    // so ties are resolved by the smaller triangle index regardless of the number of threads.
+    parallel_for(0, tiles_y, [&](int ty) {
+        int band_begin = ty * TileSize;
+        int band_end = std::min(band_begin + TileSize, height);
+        std::fill(depth.begin() + band_begin * width, depth.begin() + band_end * width, FLT_MAX);
+        std::fill(tindices.begin() + band_begin * width, tindices.begin() + band_end * width, -1);
+
+        auto rasterize = [&](const float3& p0, const float3& p1, const float3& p2, int ti) {
+            float area = (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x);
+            if (area == 0.0f || !std::isfinite(area)) { return; }
+
+            float fy0 = std::max(std::min(std::min(p0.y, p1.y), p2.y), (float)band_begin);
+            float fy1 = std::min(std::max(std::max(p0.y, p1.y), p2.y), (float)band_end);
+            float fx0 = std::max(std::min(std::min(p0.x, p1.x), p2.x), 0.0f);
+            float fx1 = std::min(std::max(std::max(p0.x, p1.x), p2.x), (float)width);
+            if (fy0 >= fy1 || fx0 >= fx1) { return; }
+
+            int y0 = (int)fy0, y1 = std::min((int)fy1, band_end - 1);
+            int x0 = (int)fx0, x1 = std::min((int)fx1, width - 1);
+            float ia = 1.0f / area;
+            for (int y = y0; y <= y1; ++y) {
+                float py = y + 0.5f;
+                for (int x = x0; x <= x1; ++x) {
+                    float px = x + 0.5f;
+                    float b0 = ((p1.x - px) * (p2.y - py) - (p1.y - py) * (p2.x - px)) * ia;
+                    float b1 = ((p2.x - px) * (p0.y - py) - (p2.y - py) * (p0.x - px)) * ia;
+                    float b2 = 1.0f - b0 - b1;
+                    if (b0 < 0.0f || b1 < 0.0f || b2 < 0.0f) { continue; }
+
+                    float z = p0.z * b0 + p1.z * b1 + p2.z * b2;
+                    int pi = y * width + x;
+                    if (z < depth[pi]) {
+                        depth[pi] = z;
+                        tindices[pi] = ti;
+                    }
+                }
+            }
+        };
+
+        int *offsets = &tile_offsets[ty * tiles_x];
+        std::fill(offsets, offsets + tiles_x, 0);
+        for (int i = row_offsets[ty]; i < row_offsets[ty + 1]; ++i) {
+            int ti = row_triangles[i];
+            const float3 *poly = &polygons[ti * 4];
+            for (int j = 2; j < counts[ti]; ++j) {
+                rasterize(poly[0], poly[j - 1], poly[j], ti);
+            }
+
+            auto& tr = tiles[ti];
+            for (int tx = tr.x0; tx <= tr.x1; ++tx) { ++offsets[tx]; }
+        }
+
+        // tiles of this row: count -> offset -> fill, then sort by near_w
+        int base = row_bases[ty];
+        for (int tx = 0; tx < tiles_x; ++tx) {
+            int n = offsets[tx];
+            offsets[tx] = base;
+            base += n;
+        }
+        RawVector<int> pos;
+        pos.assign(offsets, offsets + tiles_x);
+        for (int i = row_offsets[ty]; i < row_offsets[ty + 1]; ++i) {
+            int ti = row_triangles[i];
+            auto& tr = tiles[ti];
+            for (int tx = tr.x0; tx <= tr.x1; ++tx) { tile_triangles[pos[tx]++] = ti; }
+        }
+        for (int tx = 0; tx < tiles_x; ++tx) {
+            std::sort(tile_triangles.begin() + offsets[tx], tile_triangles.begin() + pos[tx], [&](int a, int b) {
+                return near_w[a] < near_w[b] || (near_w[a] == near_w[b] && a < b);
+            });
+        }
+    });
+}
+
+bool DepthBuffer::getPixel(const float4& vp, int& x, int& y) const
+{
+    if (tindices.empty() || !(vp.w > 0.0f)) { return false; }
+
+    float fx = (vp.x / vp.w * 0.5f + 0.5f) * width;
+    float fy = (vp.y / vp.w * 0.5f + 0.5f) * height;
+    if (!(fx >= 0.0f && fx < (float)width && fy >= 0.0f && fy < (float)height)) { return false; }
+    x = (int)fx;
+    y = (int)fy;
+    return true;
+}
+
+int DepthBuffer::getTriangle(int x, int y) const
+{
+    if (x < 0 || x >= width || y < 0 || y >= height) { return -1; }
+    return tindices[y * width + x];
+}
+
+int DepthBuffer::getTileTriangles(int x, int y, const int *& triangles) const
+{
+    if (x < 0 || x >= width || y < 0 || y >= height) { return 0; }
+    int t = (y / TileSize) * tiles_x + (x / TileSize);
+    triangles = tile_triangles.data() + tile_offsets[t];
+    return tile_offsets[t + 1] - tile_offsets[t];
+}
+
+} // namespace mu
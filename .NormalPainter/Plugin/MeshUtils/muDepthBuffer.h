@@ -0,0 +1,40 @@
+#pragma once
+
+namespace mu {
+
+// software z-buffer that holds the front-most triangle of each pixel.
+// pixels cover [-1, 1] of normalized device coordinates. no backface culling, same as raycasts.
+// triangles are binned into tiles of TileSize pixels by their screen bounds (with a margin of a pixel), so the triangles
+// that may cover any point of a tile are known exactly, not only the ones that cover pixel centers.
+struct DepthBuffer
+{
+    static const int TileSize = 8;
+
+    int width = 0, height = 0;
+    float4x4 mvp = float4x4::identity();
+    float depth_sign = 1.0f;    // -1 if device depth decreases as distance increases (reversed z)
+    RawVector<float> depth;     // device depth * depth_sign
+    RawVector<int> tindices;    // front-most triangle index. -1 if empty
+
+    int tiles_x = 0, tiles_y = 0;
+    RawVector<int> tile_offsets;    // tiles_x * tiles_y + 1
+    RawVector<int> tile_triangles;  // triangles of each tile in ascending order of near_w
+    RawVector<float> near_w;        // per triangle: smallest clip space w of the part in front of the near plane
+    RawVector<int> near_triangles;  // triangles reaching between the eye and the near plane. that part is not binned
+
+    void clear();
+    bool empty() const;
+
+    // eye: viewpoint in the same space as vertices. used only to determine the direction of depth.
+    void build(const float4x4& mvp, float3 eye, const IArray<int>& indices, const IArray<float3>& vertices, int width, int height);
+
+    // vp: clip space position. returns false if vp is out of the buffer.
+    bool getPixel(const float4& vp, int& x, int& y) const;
+    // returns -1 if no triangle covers the pixel or (x, y) is out of the buffer.
+    int getTriangle(int x, int y) const;
+    // triangles that may cover any point of the pixel (x, y) in ascending order of near_w.
+    // near_triangles are not included. returns 0 if (x, y) is out of the buffer.
+    int getTileTriangles(int x, int y, const int *& triangles) const;
+};
+
+} // namespace mu
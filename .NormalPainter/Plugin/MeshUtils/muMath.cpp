@@ -108,6 +108,24 @@ bool NearEqual_Generic(const float *src1, const float *src2, size_t num, float e
     return true;
 }
 
+int WeightedSum_Generic(const float3 *src, const float *weights, size_t num, float3& dst_sum, float& dst_weight)
+{
+    float3 sum = float3::zero();
+    float total = 0.0f;
+    int n = 0;
+    for (size_t i = 0; i < num; ++i) {
+        float w = weights[i];
+        if (w > 0.0f) {
+            sum += src[i] * w;
+            total += w;
+            ++n;
+        }
+    }
+    dst_sum = sum;
+    dst_weight = total;
+    return n;
+}
+
 void MulPoints_Generic(const float4x4& m, const float3 src[], float3 dst[], size_t num_data)
 {
     for (int i = 0; i < (int)num_data; ++i) {
@@ -120,6 +138,15 @@ void MulVectors_Generic(const float4x4& m, const float3 src[], float3 dst[], siz
         dst[i] = mul_v(m, src[i]);
     }
 }
+void ProjectPoints_Generic(const float4x4& m, const float3 src[], float dst_x[], float dst_y[], float dst_z[], size_t num_data)
+{
+    for (int i = 0; i < (int)num_data; ++i) {
+        float4 r = mul4(m, src[i]);
+        dst_x[i] = r.x / r.w;
+        dst_y[i] = r.y / r.w;
+        dst_z[i] = r.z;
+    }
+}
 
 int RayTrianglesIntersectionIndexed_Generic(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles, int& tindex, float& distance)
 {
@@ -182,6 +209,61 @@ int RayTrianglesIntersectionSoA_Generic(float3 pos, float3 dir,
     return num_hits;
 }
 
+int RayTrianglesIntersectionClustered_Generic(float3 pos, float3 dir,
+    const float *v1x, const float *v1y, const float *v1z,
+    const float *v2x, const float *v2y, const float *v2z,
+    const float *v3x, const float *v3y, const float *v3z,
+    const float3 *cluster_bb_min, const float3 *cluster_bb_max, const int *cluster_offsets, int num_clusters,
+    int& tindex, float& distance)
+{
+    int num_hits = 0;
+    distance = FLT_MAX;
+
+    float3 idir = safe_inv_dir(dir);
+    for (int ci = 0; ci < num_clusters; ++ci) {
+        // slab test
+        float3 t1 = (cluster_bb_min[ci] - pos) * idir;
+        float3 t2 = (cluster_bb_max[ci] - pos) * idir;
+        float tnear = std::max(std::max(std::min(t1.x, t2.x), std::min(t1.y, t2.y)), std::min(t1.z, t2.z));
+        float tfar = std::min(std::min(std::max(t1.x, t2.x), std::max(t1.y, t2.y)), std::max(t1.z, t2.z));
+        if (tnear > tfar || tfar < 0.0f || tnear > distance) { continue; }
+
+        int begin = cluster_offsets[ci];
+        int ti;
+        float d;
+        int n = RayTrianglesIntersectionSoA_Generic(pos, dir,
+            v1x + begin, v1y + begin, v1z + begin,
+            v2x + begin, v2y + begin, v2z + begin,
+            v3x + begin, v3y + begin, v3z + begin,
+            cluster_offsets[ci + 1] - begin, ti, d);
+        if (n > 0) {
+            num_hits += n;
+            if (d < distance) {
+                distance = d;
+                tindex = begin + ti;
+            }
+        }
+    }
+    return num_hits;
+}
+
+bool RayTrianglesOcclusionIndexed_Generic(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles,
+    int ignore_vertex, float max_distance)
+{
+    for (int i = 0; i < num_triangles; ++i) {
+        int i1 = indices[i * 3 + 0];
+        int i2 = indices[i * 3 + 1];
+        int i3 = indices[i * 3 + 2];
+        if (i1 == ignore_vertex || i2 == ignore_vertex || i3 == ignore_vertex) { continue; }
+
+        float d;
+        if (ray_triangle_intersection(pos, dir, vertices[i1], vertices[i2], vertices[i3], d) && d < max_distance) {
+            return true;
+        }
+    }
+    return false;
+}
+
 
 bool PolyInside_Generic(const float2 points[], int num_points, const float2 minp, const float2 maxp, const float2 pos)
 {
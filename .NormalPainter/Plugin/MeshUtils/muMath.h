@@ -1080,9 +1080,10 @@ template<class T> inline T compute_focal_length(T aperture, T fov)
 }
 
 
+// u, v: barycentric coordinates of p2 and p3 at the hit position
 template<class T>
 inline bool ray_triangle_intersection(
-    const tvec3<T>& pos, const tvec3<T>& dir, const tvec3<T>& p1, const tvec3<T>& p2, const tvec3<T>& p3, T& distance)
+    const tvec3<T>& pos, const tvec3<T>& dir, const tvec3<T>& p1, const tvec3<T>& p2, const tvec3<T>& p3, T& distance, T& u, T& v)
 {
     const T epsdet = 1e-10f;
     const T eps = 1e-4f;
@@ -1094,16 +1095,81 @@ inline bool ray_triangle_intersection(
     if (abs(det) < epsdet) return false;
     auto inv_det = T(1.0) / det;
     auto t = pos - p1;
-    auto u = dot(t, p) * inv_det;
+    u = dot(t, p) * inv_det;
     if (u < -eps || u  > 1 + eps) return false;
     auto q = cross(t, e1);
-    auto v = dot(dir, q) * inv_det;
+    v = dot(dir, q) * inv_det;
     if (v < -eps || u + v > 1 + eps) return false;
 
     distance = dot(e2, q) * inv_det;
     return distance >= T(0.0);
 }
 
+template<class T>
+inline bool ray_triangle_intersection(
+    const tvec3<T>& pos, const tvec3<T>& dir, const tvec3<T>& p1, const tvec3<T>& p2, const tvec3<T>& p3, T& distance)
+{
+    T u, v;
+    return ray_triangle_intersection(pos, dir, p1, p2, p3, distance, u, v);
+}
+
+// 1 / dir for slab tests. near-zero components are replaced by +-eps to avoid inf * 0 = NaN.
+template<class T>
+inline tvec3<T> safe_inv_dir(const tvec3<T>& dir)
+{
+    const T eps = T(1e-20);
+    auto inv = [eps](T v) { return T(1.0) / (abs(v) < eps ? (v < T(0.0) ? -eps : eps) : v); };
+    return{ inv(dir.x), inv(dir.y), inv(dir.z) };
+}
+
+// nearest point on the triangle from pos. u, v: barycentric coordinates of p2 and p3 at the nearest point
+template<class T>
+inline tvec3<T> closest_point_on_triangle(
+    const tvec3<T>& pos, const tvec3<T>& p1, const tvec3<T>& p2, const tvec3<T>& p3, T& u, T& v)
+{
+    auto e1 = p2 - p1;
+    auto e2 = p3 - p1;
+    auto f1 = pos - p1;
+    auto d1 = dot(e1, f1);
+    auto d2 = dot(e2, f1);
+    if (d1 <= T(0.0) && d2 <= T(0.0)) { u = v = T(0.0); return p1; }
+
+    auto f2 = pos - p2;
+    auto d3 = dot(e1, f2);
+    auto d4 = dot(e2, f2);
+    if (d3 >= T(0.0) && d4 <= d3) { u = T(1.0); v = T(0.0); return p2; }
+
+    auto vc = d1 * d4 - d3 * d2;
+    if (vc <= T(0.0) && d1 >= T(0.0) && d3 <= T(0.0)) {
+        u = d1 / (d1 - d3); v = T(0.0);
+        return p1 + e1 * u;
+    }
+
+    auto f3 = pos - p3;
+    auto d5 = dot(e1, f3);
+    auto d6 = dot(e2, f3);
+    if (d6 >= T(0.0) && d5 <= d6) { u = T(0.0); v = T(1.0); return p3; }
+
+    auto vb = d5 * d2 - d1 * d6;
+    if (vb <= T(0.0) && d2 >= T(0.0) && d6 <= T(0.0)) {
+        u = T(0.0); v = d2 / (d2 - d6);
+        return p1 + e2 * v;
+    }
+
+    auto va = d3 * d6 - d5 * d4;
+    if (va <= T(0.0) && (d4 - d3) >= T(0.0) && (d5 - d6) >= T(0.0)) {
+        v = (d4 - d3) / ((d4 - d3) + (d5 - d6)); u = T(1.0) - v;
+        return p2 + (p3 - p2) * v;
+    }
+
+    auto sum = va + vb + vc;
+    if (sum <= T(0.0)) { u = v = T(0.0); return p1; } // degenerated
+    auto denom = T(1.0) / sum;
+    u = vb * denom;
+    v = vc * denom;
+    return p1 + e1 * u + e2 * v;
+}
+
 // pos must be on the triangle
 template<class T, class U>
 inline U triangle_interpolation(
@@ -0,0 +1,510 @@
+#include "pch.h"
+#include "MeshUtils.h"
+
+namespace mu {
+
+static const int PointGridPointsPerCell = 8;
+
+static inline bool is_finite(const float3& v)
+{
+    return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+}
+
+void PointGrid::clear()
+{
+    bb_min = float3::zero();
+    cell_size = 0.0f;
+    dim[0] = dim[1] = dim[2] = 0;
+    points.clear();
+    indices.clear();
+    offsets.clear();
+}
+
+bool PointGrid::empty() const
+{
+    return points.empty();
+}
+
+int PointGrid::getCell(float v, int axis) const
+{
+    // NaN goes to the first cell. casting it (or anything out of the int range) is undefined.
+    float c = std::floor((v - bb_min[axis]) / cell_size);
+    if (!(c > 0.0f)) { return 0; }
+    return (int)std::min(c, (float)(dim[axis] - 1));
+}
+
+void PointGrid::build(const IArray<float3>& points_, float cell_size_)
+{
+    clear();
+    int num_points = (int)points_.size();
+    if (num_points == 0) { return; }
+
+    points.assign(points_.begin(), points_.end());
+
+    float3 bmax;
+    MinMax(points.data(), num_points, bb_min, bmax);
+    if (!is_finite(bb_min) || !is_finite(bmax)) {
+        // bounds of finite points only. non-finite points are clamped into the border cells.
+        bb_min = bmax = float3::zero();
+        bool first = true;
+        for (auto& p : points) {
+            if (!is_finite(p)) { continue; }
+            if (first) { bb_min = bmax = p; first = false; }
+            else { bb_min = min(bb_min, p); bmax = max(bmax, p); }
+        }
+    }
+    float3 extent = bmax - bb_min;
+    for (int i = 0; i < 3; ++i) {
+        // can overflow if points are spread wider than the float range
+        extent[i] = std::min(extent[i], std::numeric_limits<float>::max());
+    }
+    float max_extent = std::max(std::max(extent.x, extent.y), extent.z);
+
+    cell_size = cell_size_;
+    if (cell_size <= 0.0f) {
+        cell_size = max_extent / std::sqrt(std::max((float)num_points / PointGridPointsPerCell, 1.0f));
+    }
+    if (!(cell_size > 0.0f)) { cell_size = 1.0f; }
+
+    // limit the number of cells. volumetric point clouds would make too many cells with the size for surfaces.
+    for (;;) {
+        double num_cells = 1.0;
+        for (int i = 0; i < 3; ++i) {
+            num_cells *= std::floor(extent[i] / cell_size) + 1.0;
+        }
+        if (num_cells <= (double)num_points) { break; }
+        cell_size *= 1.25f;
+    }
+    for (int i = 0; i < 3; ++i) {
+        dim[i] = (int)(extent[i] / cell_size) + 1;
+    }
+    int num_cells = dim[0] * dim[1] * dim[2];
+
+    RawVector<int> cells;
+    cells.resize_discard(num_points);
+    parallel_for_blocked(0, num_points, 1024, [&](int pi, int pend) {
+        for (; pi < pend; ++pi) {
+            auto& p = points[pi];
+            cells[pi] = (getCell(p.z, 2) * dim[1] + getCell(p.y, 1)) * dim[0] + getCell(p.x, 0);
+        }
+    });
+
+    // counting sort. stable, so indices are ascending in each cell.
+    offsets.resize_zeroclear(num_cells + 1);
+    for (int pi = 0; pi < num_points; ++pi) {
+        ++offsets[cells[pi] + 1];
+    }
+    for (int ci = 0; ci < num_cells; ++ci) {
+        offsets[ci + 1] += offsets[ci];
+    }
+    RawVector<int> pos;
+    pos.assign(offsets.begin(), offsets.end() - 1);
+    indices.resize_discard(num_points);
+    for (int pi = 0; pi < num_points; ++pi) {
+        indices[pos[cells[pi]]++] = pi;
+    }
+}
+
+void PointGrid::gather(float3 pos, float radius, RawVector<int>& dst) const
+{
+    dst.clear();
+    if (points.empty() || !(radius >= 0.0f)) { return; }
+
+    int num_points = (int)points.size();
+    float rq = radius * radius;
+    auto test = [&](int pi) {
+        if (length_sq(points[pi] - pos) <= rq) {
+            dst.push_back(pi);
+        }
+    };
+
+    int lo[3], hi[3];
+    double num_cells = 1.0;
+    for (int i = 0; i < 3; ++i) {
+        lo[i] = getCell(pos[i] - radius, i);
+        hi[i] = getCell(pos[i] + radius, i);
+        num_cells *= hi[i] - lo[i] + 1;
+    }
+
+    // if the sphere covers a large part of the grid, scanning all points is cheaper (and needs no sort)
+    if (num_cells * 4.0 > (double)(dim[0] * dim[1] * dim[2])) {
+        for (int pi = 0; pi < num_points; ++pi) {
+            test(pi);
+        }
+        return;
+    }
+
+    // cells in a row along x are contiguous
+    for (int z = lo[2]; z <= hi[2]; ++z) {
+        for (int y = lo[1]; y <= hi[1]; ++y) {
+            int row = (z * dim[1] + y) * dim[0];
+            int end = offsets[row + hi[0] + 1];
+            for (int i = offsets[row + lo[0]]; i < end; ++i) {
+                test(indices[i]);
+            }
+        }
+    }
+    std::sort(dst.begin(), dst.end());
+}
+
+void PointGrid::gatherSwept(const float3 *path, int num_path, float radius, RawVector<int>& dst) const
+{
+    dst.clear();
+    if (points.empty() || num_path <= 0 || !(radius >= 0.0f)) { return; }
+
+    // bin segments into non-empty cells. segments are split into pieces of about a cell so that their bounds stay tight.
+    // bounds are padded a little to be conservative against rounding of the pieces.
+    int num_points = (int)points.size();
+    int num_cells = dim[0] * dim[1] * dim[2];
+    int num_segments = std::max(num_path - 1, 1);
+    float pad = radius + cell_size * 1e-3f;
+
+    // each group is a cell and the segments overlapping it: segments[seg_begin] - segments[seg_end - 1] in ascending order
+    struct Group { int cell, seg_begin, seg_end, last_segment; };
+    struct Bin { int group, segment; };
+    RawVector<Group> groups;
+    RawVector<Bin> bins;
+    RawVector<int> cell_groups;
+    cell_groups.resize(num_cells, -1);
+    auto add_bin = [&](int ci, int si) {
+        int np = offsets[ci + 1] - offsets[ci];
+        if (np == 0) { return; }
+        int& gi = cell_groups[ci];
+        if (gi == -1) {
+            gi = (int)groups.size();
+            groups.push_back({ ci, 0, 0, -1 });
+        }
+        // pieces of a segment may overlap the same cell
+        auto& g = groups[gi];
+        if (g.last_segment != si) {
+            g.last_segment = si;
+            ++g.seg_end;
+            bins.push_back({ gi, si });
+        }
+    };
+
+    bool scan_all = false;
+    for (int si = 0; si < num_segments && !scan_all; ++si) {
+        float3 a = path[si], b = path[std::min(si + 1, num_path - 1)];
+        int num_pieces = std::max((int)std::min(std::ceil(length(b - a) / cell_size), 1024.0f), 1);
+        for (int k = 0; k < num_pieces; ++k) {
+            float3 pa = lerp(a, b, (float)k / num_pieces);
+            float3 pb = lerp(a, b, (float)(k + 1) / num_pieces);
+            int lo[3], hi[3];
+            for (int i = 0; i < 3; ++i) {
+                lo[i] = getCell(std::min(pa[i], pb[i]) - pad, i);
+                hi[i] = getCell(std::max(pa[i], pb[i]) + pad, i);
+            }
+            for (int z = lo[2]; z <= hi[2]; ++z) {
+                for (int y = lo[1]; y <= hi[1]; ++y) {
+                    int row = (z * dim[1] + y) * dim[0];
+                    for (int x = lo[0]; x <= hi[0]; ++x) {
+                        add_bin(row + x, si);
+                    }
+                }
+            }
+            // the capsules cover a large part of the grid. testing all points with all segments is cheaper
+            if ((double)bins.size() * PointGridPointsPerCell > (double)num_points * num_segments) {
+                scan_all = true;
+                break;
+            }
+        }
+    }
+
+    RawVector<int> segments;
+    if (scan_all) {
+        groups.clear();
+        for (int si = 0; si < num_segments; ++si) { segments.push_back(si); }
+        for (int ci = 0; ci < num_cells; ++ci) {
+            if (offsets[ci + 1] > offsets[ci]) { groups.push_back({ ci, 0, num_segments, -1 }); }
+        }
+    }
+    else {
+        // counting sort of bins by group. stable, so segments of each group stay ascending.
+        int num_bins = 0;
+        for (auto& g : groups) {
+            int count = g.seg_end;
+            g.seg_begin = g.seg_end = num_bins;
+            num_bins += count;
+        }
+        segments.resize_discard(num_bins);
+        for (auto& bin : bins) {
+            segments[groups[bin.group].seg_end++] = bin.segment;
+        }
+    }
+
+    // each point is tested once, only against the segments of its cell. points belong to one cell, so flags don't conflict.
+    float rq = radius * radius;
+    RawVector<char> inside;
+    inside.resize_zeroclear(num_points);
+    parallel_for_blocked(0, (int)groups.size(), 16, [&](int gi, int gend) {
+        for (; gi < gend; ++gi) {
+            auto& g = groups[gi];
+            for (int i = offsets[g.cell]; i < offsets[g.cell + 1]; ++i) {
+                int pi = indices[i];
+                float3 p = points[pi];
+                bool hit = false;
+                for (int k = g.seg_begin; k < g.seg_end && !hit; ++k) {
+                    int si = segments[k];
+                    float3 a = path[si], b = path[std::min(si + 1, num_path - 1)];
+                    float3 ab = b - a;
+                    float lq = length_sq(ab);
+                    float t = lq > 0.0f ? clamp01(dot(p - a, ab) / lq) : 0.0f;
+                    // ends are tested directly too, as a + ab may differ from b by rounding
+                    hit = length_sq(a + ab * t - p) <= rq || length_sq(a - p) <= rq || length_sq(b - p) <= rq;
+                }
+                inside[pi] = hit;
+            }
+        }
+    });
+
+    // scanning flags of all points is cheaper than sorting the result
+    for (int pi = 0; pi < num_points; ++pi) {
+        if (inside[pi]) { dst.push_back(pi); }
+    }
+}
+
+
+
+static inline uint64_t HashCell(int64_t x, int64_t y, int64_t z)
+{
+    uint64_t h = (uint64_t)x * 0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t)y * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+    h ^= (uint64_t)z * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+    return h ^ (h >> 29);
+}
+
+void PointHashGrid::clear()
+{
+    epsilon = 0.0f;
+    cell_size = 0.0;
+    points.clear();
+    indices.clear();
+    cells.clear();
+    buckets.clear();
+}
+
+bool PointHashGrid::empty() const
+{
+    return points.empty();
+}
+
+bool PointHashGrid::getCell(float3 p, int64_t& x, int64_t& y, int64_t& z) const
+{
+    // casting NaN or out of range values to int64 is undefined, so non-finite points have no cell
+    if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) { return false; }
+
+    const double limit = 4e18;
+    auto q = [&](float v) {
+        double c = std::floor((double)v / cell_size);
+        return (int64_t)std::min(std::max(c, -limit), limit);
+    };
+    x = q(p.x);
+    y = q(p.y);
+    z = q(p.z);
+    return true;
+}
+
+int PointHashGrid::findCell(int64_t x, int64_t y, int64_t z) const
+{
+    int bi = (int)(HashCell(x, y, z) & (uint64_t)(buckets.size() - 2));
+    for (int ci = buckets[bi]; ci < buckets[bi + 1]; ++ci) {
+        auto& c = cells[ci];
+        if (c.x == x && c.y == y && c.z == z) { return ci; }
+    }
+    return -1;
+}
+
+void PointHashGrid::build(const IArray<float3>& points_, float epsilon_)
+{
+    clear();
+    int num_points = (int)points_.size();
+    if (num_points == 0) { return; }
+
+    points.assign(points_.begin(), points_.end());
+    epsilon = epsilon_;
+    // slightly larger than epsilon so that points closer than epsilon are always in adjacent cells despite rounding
+    cell_size = std::max((double)epsilon * 1.0001, 1e-30);
+
+    int num_buckets = 1;
+    while (num_buckets < num_points) { num_buckets <<= 1; }
+    uint64_t mask = (uint64_t)num_buckets - 1;
+
+    struct CellCoord { int64_t x, y, z; };
+    RawVector<CellCoord> coords;
+    RawVector<int> point_buckets;
+    coords.resize_discard(num_points);
+    point_buckets.resize_discard(num_points);
+    parallel_for_blocked(0, num_points, 1024, [&](int pi, int pend) {
+        for (; pi < pend; ++pi) {
+            auto& c = coords[pi];
+            point_buckets[pi] = getCell(points[pi], c.x, c.y, c.z) ? (int)(HashCell(c.x, c.y, c.z) & mask) : -1;
+        }
+    });
+
+    // counting sort by bucket. stable, so indices are ascending in each bucket.
+    RawVector<int> offsets;
+    offsets.resize_zeroclear(num_buckets + 1);
+    for (int pi = 0; pi < num_points; ++pi) {
+        if (point_buckets[pi] != -1) { ++offsets[point_buckets[pi] + 1]; }
+    }
+    for (int bi = 0; bi < num_buckets; ++bi) {
+        offsets[bi + 1] += offsets[bi];
+    }
+    {
+        RawVector<int> pos;
+        pos.assign(offsets.begin(), offsets.end() - 1);
+        indices.resize_discard(offsets[num_buckets]);
+        for (int pi = 0; pi < num_points; ++pi) {
+            if (point_buckets[pi] != -1) { indices[pos[point_buckets[pi]]++] = pi; }
+        }
+    }
+
+    // split buckets into cells. points of different cells in a bucket are grouped by coordinates.
+    auto same = [&](int a, int b) {
+        auto& ca = coords[a];
+        auto& cb = coords[b];
+        return ca.x == cb.x && ca.y == cb.y && ca.z == cb.z;
+    };
+    buckets.resize_zeroclear(num_buckets + 1);
+    parallel_for_blocked(0, num_buckets, 1024, [&](int bi, int bend) {
+        for (; bi < bend; ++bi) {
+            int *first = &indices[offsets[bi]];
+            int *last = &indices[offsets[bi + 1]];
+            if (first == last) { continue; }
+            for (int *i = first + 1; i < last; ++i) {
+                if (!same(*i, *first)) {
+                    std::stable_sort(first, last, [&](int a, int b) {
+                        auto& ca = coords[a];
+                        auto& cb = coords[b];
+                        if (ca.x != cb.x) { return ca.x < cb.x; }
+                        if (ca.y != cb.y) { return ca.y < cb.y; }
+                        return ca.z < cb.z;
+                    });
+                    break;
+                }
+            }
+            int n = 1;
+            for (int *i = first + 1; i < last; ++i) {
+                if (!same(*i, *(i - 1))) { ++n; }
+            }
+            buckets[bi + 1] = n;
+        }
+    });
+    for (int bi = 0; bi < num_buckets; ++bi) {
+        buckets[bi + 1] += buckets[bi];
+    }
+
+    cells.resize_discard(buckets[num_buckets]);
+    parallel_for_blocked(0, num_buckets, 1024, [&](int bi, int bend) {
+        for (; bi < bend; ++bi) {
+            int ci = buckets[bi];
+            for (int i = offsets[bi]; i < offsets[bi + 1]; ++i) {
+                if (i == offsets[bi] || !same(indices[i], indices[i - 1])) {
+                    auto& c = coords[indices[i]];
+                    cells[ci++] = { c.x, c.y, c.z, i, 0 };
+                }
+                ++cells[ci - 1].count;
+            }
+        }
+    });
+}
+
+void PointHashGrid::gather(float3 pos, RawVector<int>& dst) const
+{
+    dst.clear();
+    if (points.empty()) { return; }
+
+    int64_t x, y, z;
+    if (!getCell(pos, x, y, z)) { return; }
+    for (int64_t dz = -1; dz <= 1; ++dz) {
+        for (int64_t dy = -1; dy <= 1; ++dy) {
+            for (int64_t dx = -1; dx <= 1; ++dx) {
+                int ci = findCell(x + dx, y + dy, z + dz);
+                if (ci == -1) { continue; }
+                auto& c = cells[ci];
+                for (int i = c.first; i < c.first + c.count; ++i) {
+                    int pi = indices[i];
+                    if (length(points[pi] - pos) < epsilon) {
+                        dst.push_back(pi);
+                    }
+                }
+            }
+        }
+    }
+    std::sort(dst.begin(), dst.end());
+}
+
+void PointHashGrid::gatherAll(RawVector<int>& offsets, RawVector<int>& dst) const
+{
+    int num_points = (int)points.size();
+    int num_cells = (int)cells.size();
+    // points without a cell (non-finite) stay 0
+    offsets.resize_zeroclear(num_points + 1);
+    dst.clear();
+    if (num_points == 0) { return; }
+
+    // occupied adjacent cells (including itself) of a cell. looked up on the fly, once per cell and pass.
+    auto adjacent = [&](int ci, int *adj) {
+        auto& c = cells[ci];
+        int n = 0;
+        for (int64_t dz = -1; dz <= 1; ++dz) {
+            for (int64_t dy = -1; dy <= 1; ++dy) {
+                for (int64_t dx = -1; dx <= 1; ++dx) {
+                    int ai = (dx | dy | dz) == 0 ? ci : findCell(c.x + dx, c.y + dy, c.z + dz);
+                    if (ai != -1) { adj[n++] = ai; }
+                }
+            }
+        }
+        return n;
+    };
+
+    // 2 passes: count, then fill
+    auto each = [&](const int *adj, int num_adj, int i, RawVector<int>& tmp) {
+        int pi = indices[i];
+        float3 pos = points[pi];
+        tmp.clear();
+        for (int k = 0; k < num_adj; ++k) {
+            auto& c = cells[adj[k]];
+            for (int j = c.first; j < c.first + c.count; ++j) {
+                int pj = indices[j];
+                if (length(points[pj] - pos) < epsilon) {
+                    tmp.push_back(pj);
+                }
+            }
+        }
+        return pi;
+    };
+    parallel_for_blocked(0, num_cells, 1024, [&](int ci, int cend) {
+        RawVector<int> tmp;
+        int adj[27];
+        for (; ci < cend; ++ci) {
+            auto& c = cells[ci];
+            int num_adj = adjacent(ci, adj);
+            for (int i = c.first; i < c.first + c.count; ++i) {
+                int pi = each(adj, num_adj, i, tmp);
+                offsets[pi + 1] = (int)tmp.size();
+            }
+        }
+    });
+    offsets[0] = 0;
+    for (int pi = 0; pi < num_points; ++pi) {
+        offsets[pi + 1] += offsets[pi];
+    }
+    dst.resize_discard(offsets[num_points]);
+    parallel_for_blocked(0, num_cells, 1024, [&](int ci, int cend) {
+        RawVector<int> tmp;
+        int adj[27];
+        for (; ci < cend; ++ci) {
+            auto& c = cells[ci];
+            int num_adj = adjacent(ci, adj);
+            for (int i = c.first; i < c.first + c.count; ++i) {
+                int pi = each(adj, num_adj, i, tmp);
+                std::sort(tmp.begin(), tmp.end());
+                std::copy(tmp.begin(), tmp.end(), &dst[offsets[pi]]);
+            }
+        }
+    });
+}
+
+} // namespace mu
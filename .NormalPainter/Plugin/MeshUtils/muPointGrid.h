@@ -0,0 +1,67 @@
+#pragma once
+
+namespace mu {
+
+// uniform grid of points over their bounds. points are sorted by cell, so each cell is a contiguous range.
+// points are copied, so rebuild when they are moved.
+struct PointGrid
+{
+    float3 bb_min = float3::zero();
+    float cell_size = 0.0f;
+    int dim[3] = { 0, 0, 0 };
+    RawVector<float3> points;   // copy of points. indexed by original index
+    RawVector<int> indices;     // sorted by cell -> original index (ascending in each cell)
+    RawVector<int> offsets;     // points of cell i are indices[offsets[i]] - indices[offsets[i + 1] - 1]
+
+    void clear();
+    bool empty() const;
+
+    // cell_size: <= 0 to choose a size that makes about 8 points per cell if points are on surfaces.
+    // the number of cells is limited to about the number of points.
+    void build(const IArray<float3>& points, float cell_size = 0.0f);
+
+    // gathers indices of points within radius (length_sq(p - pos) <= radius * radius) in ascending order.
+    void gather(float3 pos, float radius, RawVector<int>& dst) const;
+    // gathers indices of points within radius of the polyline path (capsules around its segments, or the sphere around
+    // path[0] if num_path is 1) in ascending order. each cell is tested only with the segments whose bounds overlap it.
+    void gatherSwept(const float3 *path, int num_path, float radius, RawVector<int>& dst) const;
+
+private:
+    int getCell(float v, int axis) const;
+};
+
+// hashed grid for finding coincident points (length(p - pos) < epsilon). cells are epsilon sized and only occupied cells are stored,
+// so it works regardless of the extent of points.
+struct PointHashGrid
+{
+    struct Cell
+    {
+        int64_t x, y, z;
+        int first, count; // range of indices
+    };
+
+    float epsilon = 0.0f;
+    double cell_size = 0.0;
+    RawVector<float3> points;   // copy of points. indexed by original index
+    RawVector<int> indices;     // sorted by cell -> original index (ascending in each cell). non-finite points are excluded
+    RawVector<Cell> cells;      // sorted by hash bucket
+    RawVector<int> buckets;     // cells of bucket i are cells[buckets[i]] - cells[buckets[i + 1] - 1]
+
+    void clear();
+    bool empty() const;
+
+    void build(const IArray<float3>& points, float epsilon);
+
+    // gathers indices of points that satisfy length(points[i] - pos) < epsilon in ascending order
+    void gather(float3 pos, RawVector<int>& dst) const;
+
+    // gather() for all points in the grid at once. results for point i are dst[offsets[i]] - dst[offsets[i + 1] - 1]
+    // (including i itself, unless it is non-finite). faster than calling gather() for each point, as adjacent cells are looked up once per cell.
+    void gatherAll(RawVector<int>& offsets, RawVector<int>& dst) const;
+
+private:
+    bool getCell(float3 p, int64_t& x, int64_t& y, int64_t& z) const;
+    int findCell(int64_t x, int64_t y, int64_t z) const;
+};
+
+} // namespace mu
@@ -0,0 +1,125 @@
+#include "pch.h"
+#include "MeshUtils.h"
+
+namespace mu {
+
+void PolygonMask::clear()
+{
+    bb_min = bb_max = float2::zero();
+    scale = 0.0f;
+    width = height = 0;
+    states.clear();
+    px.clear();
+    py.clear();
+}
+
+bool PolygonMask::empty() const
+{
+    return states.empty();
+}
+
+void PolygonMask::build(const float2 *points, int num_points, int resolution)
+{
+    clear();
+    if (num_points < 3 || resolution <= 0) { return; }
+
+    px.resize_discard(num_points);
+    py.resize_discard(num_points);
+    for (int i = 0; i < num_points; ++i) {
+        px[i] = points[i].x;
+        py[i] = points[i].y;
+    }
+
+    MinMax(points, num_points, bb_min, bb_max);
+    float2 extent = bb_max - bb_min;
+    float max_extent = std::max(extent.x, extent.y);
+    scale = max_extent > 0.0f ? (float)resolution / max_extent : 1.0f;
+    width = std::min(std::max((int)std::ceil(extent.x * scale), 1), resolution);
+    height = std::min(std::max((int)std::ceil(extent.y * scale), 1), resolution);
+    states.resize_discard(width * height);
+    memset(states.data(), Outside, states.size());
+
+    // interior by scanlines through pixel centers. edges are sorted by their lower end and become active row by row.
+    struct Edge { float2 p1, p2; };
+    RawVector<Edge> edges;
+    for (int i = 0; i < num_points; ++i) {
+        float2 p1 = points[i];
+        float2 p2 = points[i + 1 == num_points ? 0 : i + 1];
+        if (p1.y == p2.y) { continue; }
+        else if (p1.y > p2.y) { std::swap(p1, p2); }
+        edges.push_back({ p1, p2 });
+    }
+    std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) { return a.p1.y < b.p1.y; });
+
+    RawVector<int> active;
+    RawVector<float> xc;
+    int next_edge = 0;
+    for (int y = 0; y < height; ++y) {
+        float cy = bb_min.y + ((float)y + 0.5f) / scale;
+        while (next_edge < (int)edges.size() && edges[next_edge].p1.y <= cy) {
+            active.push_back(next_edge++);
+        }
+
+        xc.clear();
+        int n = 0;
+        for (int ei : active) {
+            auto& e = edges[ei];
+            if (cy >= e.p2.y) { continue; }
+            active[n++] = ei;
+            xc.push_back((cy - e.p1.y) * (e.p2.x - e.p1.x) / (e.p2.y - e.p1.y) + e.p1.x);
+        }
+        active.resize(n);
+        std::sort(xc.begin(), xc.end());
+
+        uint8_t *row = &states[y * width];
+        for (int i = 0; i + 1 < (int)xc.size(); i += 2) {
+            int x0 = std::max((int)std::ceil((xc[i] - bb_min.x) * scale - 0.5f), 0);
+            int x1 = std::min((int)std::ceil((xc[i + 1] - bb_min.x) * scale - 0.5f), width);
+            for (int x = x0; x < x1; ++x) {
+                row[x] = Inside;
+            }
+        }
+    }
+
+    // pixels crossed by edges, dilated by one pixel to absorb rounding errors
+    for (int i = 0; i < num_points; ++i) {
+        float2 a = (points[i] - bb_min) * scale;
+        float2 b = (points[i + 1 == num_points ? 0 : i + 1] - bb_min) * scale;
+        int r0 = std::max((int)std::floor(std::min(a.y, b.y)) - 1, 0);
+        int r1 = std::min((int)std::floor(std::max(a.y, b.y)) + 1, height - 1);
+        for (int r = r0; r <= r1; ++r) {
+            float xlo = std::min(a.x, b.x), xhi = std::max(a.x, b.x);
+            if (a.y != b.y) {
+                // part of the edge in rows [r - 1, r + 1]
+                float t0 = clamp01(((float)r - 1.0f - a.y) / (b.y - a.y));
+                float t1 = clamp01(((float)r + 2.0f - a.y) / (b.y - a.y));
+                float x0 = a.x + (b.x - a.x) * t0;
+                float x1 = a.x + (b.x - a.x) * t1;
+                xlo = std::min(x0, x1);
+                xhi = std::max(x0, x1);
+            }
+            int c0 = std::max((int)std::floor(xlo) - 1, 0);
+            int c1 = std::min((int)std::floor(xhi) + 1, width - 1);
+            uint8_t *row = &states[r * width];
+            for (int c = c0; c <= c1; ++c) {
+                row[c] = Boundary;
+            }
+        }
+    }
+}
+
+bool PolygonMask::inside(float2 pos) const
+{
+    if (states.empty()) { return false; }
+    if (!(pos.x >= bb_min.x && pos.x <= bb_max.x && pos.y >= bb_min.y && pos.y <= bb_max.y)) { return false; }
+
+    int x = std::min((int)((pos.x - bb_min.x) * scale), width - 1);
+    int y = std::min((int)((pos.y - bb_min.y) * scale), height - 1);
+    switch (states[y * width + x]) {
+    case Inside: return true;
+    case Boundary: return PolyInside(px.data(), py.data(), (int)px.size(), bb_min, bb_max, pos);
+    default: return false;
+    }
+}
+
+} // namespace mu
@@ -0,0 +1,26 @@
+#pragma once
+
+namespace mu {
+
+// polygon rasterized into pixels over its bounds (even-odd rule, same as PolyInside()).
+// points in pixels crossed by edges are tested exactly, so results match PolyInside().
+struct PolygonMask
+{
+    enum State : uint8_t { Outside, Inside, Boundary };
+
+    float2 bb_min = float2::zero(), bb_max = float2::zero();
+    float scale = 0.0f;         // pixels per unit
+    int width = 0, height = 0;
+    RawVector<uint8_t> states;  // State of each pixel
+    RawVector<float> px, py;    // polygon points for exact tests
+
+    void clear();
+    bool empty() const;
+
+    // resolution: number of pixels along the longer side of the bounds.
+    void build(const float2 *points, int num_points, int resolution = 512);
+
+    bool inside(float2 pos) const;
+};
+
+} // namespace mu
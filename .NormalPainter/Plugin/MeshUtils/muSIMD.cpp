@@ -86,6 +86,13 @@ void MinMax_ISPC(const float3 *src, size_t num, float3& dst_min, float3& dst_max
 }
 #endif
 
+#ifdef muSIMD_WeightedSum
+int WeightedSum_ISPC(const float3 *src, const float *weights, size_t num, float3& dst_sum, float& dst_weight)
+{
+    return ispc::WeightedSum((ispc::float3*)src, weights, (int)num, (ispc::float3&)dst_sum, dst_weight);
+}
+#endif
+
 #ifdef muSIMD_MulPoints3
 void MulPoints_ISPC(const float4x4& m, const float3 src[], float3 dst[], size_t num_data)
 {
@@ -98,6 +105,12 @@ void MulVectors_ISPC(const float4x4& m, const float3 src[], float3 dst[], size_t
     ispc::MulVectors3((ispc::float4x4&)m, (ispc::float3*)src, (ispc::float3*)dst, (int)num_data);
 }
 #endif
+#ifdef muSIMD_ProjectPoints
+void ProjectPoints_ISPC(const float4x4& m, const float3 src[], float dst_x[], float dst_y[], float dst_z[], size_t num_data)
+{
+    ispc::ProjectPoints((ispc::float4x4&)m, (ispc::float3*)src, dst_x, dst_y, dst_z, (int)num_data);
+}
+#endif
 
 
 #ifdef muSIMD_RayTrianglesIntersectionIndexed
@@ -130,6 +143,29 @@ int RayTrianglesIntersectionSoA_ISPC(float3 pos, float3 dir,
 }
 #endif
 
+#ifdef muSIMD_RayTrianglesIntersectionClustered
+int RayTrianglesIntersectionClustered_ISPC(float3 pos, float3 dir,
+    const float *v1x, const float *v1y, const float *v1z,
+    const float *v2x, const float *v2y, const float *v2z,
+    const float *v3x, const float *v3y, const float *v3z,
+    const float3 *cluster_bb_min, const float3 *cluster_bb_max, const int *cluster_offsets, int num_clusters,
+    int& tindex, float& distance)
+{
+    return ispc::RayTrianglesIntersectionClustered(
+        (ispc::float3&)pos, (ispc::float3&)dir, v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z,
+        (ispc::float3*)cluster_bb_min, (ispc::float3*)cluster_bb_max, cluster_offsets, num_clusters, tindex, distance);
+}
+#endif
+
+#ifdef muSIMD_RayTrianglesOcclusionIndexed
+bool RayTrianglesOcclusionIndexed_ISPC(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles,
+    int ignore_vertex, float max_distance)
+{
+    return ispc::RayTrianglesOcclusionIndexed(
+        (ispc::float3&)pos, (ispc::float3&)dir, (ispc::float3*)vertices, indices, num_triangles, ignore_vertex, max_distance);
+}
+#endif
+
 
 #ifdef muSIMD_PolyInside
 bool PolyInside_ISPC(const float2 poly[], int ngon, const float2 minp, const float2 maxp, const float2 pos)
@@ -348,6 +384,13 @@ bool NearEqual(const float4 *src1, const float4 *src2, size_t num, float eps)
 }
 #endif
 
+#if defined(muSIMD_WeightedSum) || !defined(muEnableISPC)
+int WeightedSum(const float3 *src, const float *weights, size_t num, float3& dst_sum, float& dst_weight)
+{
+    return Forward(WeightedSum, src, weights, num, dst_sum, dst_weight);
+}
+#endif
+
 #if defined(muSIMD_MulPoints3) || !defined(muEnableISPC)
 void MulPoints(const float4x4& m, const float3 src[], float3 dst[], size_t num_data)
 {
@@ -360,6 +403,12 @@ void MulVectors(const float4x4& m, const float3 src[], float3 dst[], size_t num_
     Forward(MulVectors, m, src, dst, num_data);
 }
 #endif
+#if defined(muSIMD_ProjectPoints) || !defined(muEnableISPC)
+void ProjectPoints(const float4x4& m, const float3 src[], float dst_x[], float dst_y[], float dst_z[], size_t num_data)
+{
+    Forward(ProjectPoints, m, src, dst_x, dst_y, dst_z, num_data);
+}
+#endif
 
 #if defined(muSIMD_RayTrianglesIntersectionIndexed) || !defined(muEnableISPC)
 int RayTrianglesIntersectionIndexed(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles, int& tindex, float& result)
@@ -383,6 +432,25 @@ int RayTrianglesIntersectionSoA(float3 pos, float3 dir,
     return Forward(RayTrianglesIntersectionSoA, pos, dir, v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z, num_triangles, tindex, result);
 }
 #endif
+#if defined(muSIMD_RayTrianglesIntersectionClustered) || !defined(muEnableISPC)
+int RayTrianglesIntersectionClustered(float3 pos, float3 dir,
+    const float *v1x, const float *v1y, const float *v1z,
+    const float *v2x, const float *v2y, const float *v2z,
+    const float *v3x, const float *v3y, const float *v3z,
+    const float3 *cluster_bb_min, const float3 *cluster_bb_max, const int *cluster_offsets, int num_clusters,
+    int& tindex, float& result)
+{
+    return Forward(RayTrianglesIntersectionClustered, pos, dir, v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z,
+        cluster_bb_min, cluster_bb_max, cluster_offsets, num_clusters, tindex, result);
+}
+#endif
+#if defined(muSIMD_RayTrianglesOcclusionIndexed) || !defined(muEnableISPC)
+bool RayTrianglesOcclusionIndexed(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles,
+    int ignore_vertex, float max_distance)
+{
+    return Forward(RayTrianglesOcclusionIndexed, pos, dir, vertices, indices, num_triangles, ignore_vertex, max_distance);
+}
+#endif
 
 #if defined(muSIMD_PolyInside) || !defined(muEnableISPC)
 bool PolyInside(const float2 poly[], int ngon, const float2 minp, const float2 maxp, const float2 pos)
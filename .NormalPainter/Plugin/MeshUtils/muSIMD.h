@@ -23,9 +23,13 @@ bool NearEqual(const float *src1, const float *src2, size_t num, float eps = muE
 bool NearEqual(const float2 *src1, const float2 *src2, size_t num, float eps = muEpsilon);
 bool NearEqual(const float3 *src1, const float3 *src2, size_t num, float eps = muEpsilon);
 bool NearEqual(const float4 *src1, const float4 *src2, size_t num, float eps = muEpsilon);
+// sums of src[i] * weights[i] and weights[i] over elements with weights[i] > 0. returns the number of them.
+int WeightedSum(const float3 *src, const float *weights, size_t num, float3& dst_sum, float& dst_weight);
 
 void MulPoints(const float4x4& m, const float3 src[], float3 dst[], size_t num_data);
 void MulVectors(const float4x4& m, const float3 src[], float3 dst[], size_t num_data);
+// projects points by m. dst_x / dst_y: clip xy / w, dst_z: clip z.
+void ProjectPoints(const float4x4& m, const float3 src[], float dst_x[], float dst_y[], float dst_z[], size_t num_data);
 
 int RayTrianglesIntersectionIndexed(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles, int& tindex, float& distance);
 int RayTrianglesIntersectionFlattened(float3 pos, float3 dir, const float3 *vertices, int num_triangles, int& tindex, float& distance);
@@ -39,6 +43,20 @@ int RayTrianglesIntersectionSoA(float3 pos, float3 dir,
     const float *v2x, const float *v2y, const float *v2z,
     const float *v3x, const float *v3y, const float *v3z,
     int num_triangles, int& tindex, float& distance);
+// triangles are grouped into clusters (triangles of cluster i are [cluster_offsets[i], cluster_offsets[i + 1]) of the SoA arrays).
+// clusters whose bounds are missed by the ray or farther than the current closest hit are skipped.
+// the returned hit count includes only triangles of tested clusters.
+int RayTrianglesIntersectionClustered(float3 pos, float3 dir,
+    const float *v1x, const float *v1y, const float *v1z,
+    const float *v2x, const float *v2y, const float *v2z,
+    const float *v3x, const float *v3y, const float *v3z,
+    const float3 *cluster_bb_min, const float3 *cluster_bb_max, const int *cluster_offsets, int num_clusters,
+    int& tindex, float& distance);
+
+// any-hit query. returns true if any triangle intersects the ray within [0, max_distance).
+// triangles that contain ignore_vertex are skipped (pass -1 to test all).
+bool RayTrianglesOcclusionIndexed(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles,
+    int ignore_vertex, float max_distance);
 
 bool PolyInside(const float px[], const float py[], int ngon, const float2 minp, const float2 maxp, const float2 pos);
 bool PolyInside(const float2 poly[], int ngon, const float2 minp, const float2 maxp, const float2 pos);
@@ -108,10 +126,15 @@ void MinMax_ISPC(const float3 *src, size_t num, float3& dst_min, float3& dst_max
 bool NearEqual_Generic(const float *src1, const float *src2, size_t num, float eps);
 bool NearEqual_ISPC(const float *src1, const float *src2, size_t num, float eps);
 
+int WeightedSum_Generic(const float3 *src, const float *weights, size_t num, float3& dst_sum, float& dst_weight);
+int WeightedSum_ISPC(const float3 *src, const float *weights, size_t num, float3& dst_sum, float& dst_weight);
+
 void MulPoints_Generic(const float4x4& m, const float3 src[], float3 dst[], size_t num_data);
 void MulPoints_ISPC(const float4x4& m, const float3 src[], float3 dst[], size_t num_data);
 void MulVectors_Generic(const float4x4& m, const float3 src[], float3 dst[], size_t num_data);
 void MulVectors_ISPC(const float4x4& m, const float3 src[], float3 dst[], size_t num_data);
+void ProjectPoints_Generic(const float4x4& m, const float3 src[], float dst_x[], float dst_y[], float dst_z[], size_t num_data);
+void ProjectPoints_ISPC(const float4x4& m, const float3 src[], float dst_x[], float dst_y[], float dst_z[], size_t num_data);
 
 int RayTrianglesIntersectionIndexed_Generic(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles, int& tindex, float& distance);
 int RayTrianglesIntersectionIndexed_ISPC(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles, int& tindex, float& distance);
@@ -127,6 +150,22 @@ int RayTrianglesIntersectionSoA_ISPC(float3 pos, float3 dir,
     const float *v2x, const float *v2y, const float *v2z,
     const float *v3x, const float *v3y, const float *v3z,
     int num_triangles, int& tindex, float& distance);
+int RayTrianglesIntersectionClustered_Generic(float3 pos, float3 dir,
+    const float *v1x, const float *v1y, const float *v1z,
+    const float *v2x, const float *v2y, const float *v2z,
+    const float *v3x, const float *v3y, const float *v3z,
+    const float3 *cluster_bb_min, const float3 *cluster_bb_max, const int *cluster_offsets, int num_clusters,
+    int& tindex, float& distance);
+int RayTrianglesIntersectionClustered_ISPC(float3 pos, float3 dir,
+    const float *v1x, const float *v1y, const float *v1z,
+    const float *v2x, const float *v2y, const float *v2z,
+    const float *v3x, const float *v3y, const float *v3z,
+    const float3 *cluster_bb_min, const float3 *cluster_bb_max, const int *cluster_offsets, int num_clusters,
+    int& tindex, float& distance);
+bool RayTrianglesOcclusionIndexed_Generic(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles,
+    int ignore_vertex, float max_distance);
+bool RayTrianglesOcclusionIndexed_ISPC(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles,
+    int ignore_vertex, float max_distance);
 
 bool PolyInside_Generic(const float px[], const float py[], int ngon, const float2 minp, const float2 maxp, const float2 pos);
 bool PolyInside_ISPC(const float px[], const float py[], int ngon, const float2 minp, const float2 maxp, const float2 pos);
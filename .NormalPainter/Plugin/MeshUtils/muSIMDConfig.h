@@ -9,16 +9,20 @@
 #define muSIMD_Normalize
 //#define muSIMD_Lerp
 #define muSIMD_NearEqual
+#define muSIMD_WeightedSum
 
 #define muSIMD_MinMax2
 //#define muSIMD_MinMax3
 
 //#define muSIMD_MulVectors3
 //#define muSIMD_MulPoints3
+#define muSIMD_ProjectPoints
 
 #define muSIMD_RayTrianglesIntersectionIndexed
 //#define muSIMD_RayTrianglesIntersectionFlattened
 #define muSIMD_RayTrianglesIntersectionSoA
+#define muSIMD_RayTrianglesIntersectionClustered
+#define muSIMD_RayTrianglesOcclusionIndexed
 
 //#define muSIMD_PolyInside
 #define muSIMD_PolyInsideSoA
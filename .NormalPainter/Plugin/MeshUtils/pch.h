@@ -17,6 +17,7 @@
 #include <algorithm>
 #include <numeric>
 #include <chrono>
+#include <atomic>
 
 #include "muConfig.h"
 #ifdef muEnableHalf
@@ -2,6 +2,111 @@
 #include "NormalPainter.h"
 
 #define npEpsilon 0.0000001f
+#define npVertexBlockSize 1024
+
+struct npMeshCache;
+
+// BVH of the source mesh of npProjectNormals() / npBrushProjection(), in the source's local space.
+// rays are transformed into this space, so this stays valid until the source vertices or indices are changed.
+// the source is identified by its arrays, counts and cache version (plus a few sampled elements to catch reused
+// addresses), not by its whole content. a source modified in place must be notified by npRefitMeshCache() on it.
+struct npProjectionSource
+{
+    const float3 *vertices = nullptr;
+    const int *indices = nullptr;
+    int num_vertices = 0;
+    int num_triangles = 0;
+    const npMeshCache *cache = nullptr;
+    int version = -1;
+    uint64_t samples = 0;
+    TriangleBVH bvh;
+};
+
+// compact list of selected (non-zero) vertices. native selection functions keep it current.
+// modifications by the managed side must be notified by npResetSelectionIndex().
+struct npSelectionIndex
+{
+    const float *selection = nullptr; // selection array this was built for
+    int num_vertices = 0;
+    bool valid = false;
+    bool sorted = false;
+    RawVector<int> active;      // selected vertices
+    RawVector<int> positions;   // vertex -> position in active. -1 if not selected
+
+    // running sums over vertices with selection > 0, updated with the deltas applied by the selection functions.
+    // recomputed if vertices are modified (npMeshCache::version differs).
+    int stats_version = -1;
+    int num_selected = 0;
+    double weight = 0.0;
+    double3 weighted_pos = double3::zero();
+};
+
+// vertices projected by mvp (SoA). reused while vertices and mvp are unchanged, e.g. during drag selection.
+struct npScreenPositions
+{
+    int version = -1;
+    float4x4 mvp = float4x4::identity();
+    RawVector<float> x, y;  // normalized device coordinates (clip xy / w)
+    RawVector<float> z;     // clip space z
+
+    // vertices with z > 0 bucketed by x and y. built on demand by GetScreenGrid().
+    bool has_grid = false;
+    RawVector<int> cell_offsets;    // start of each cell in cell_vertices. npScreenGridSize^2 + 1 elements
+    RawVector<int> cell_vertices;   // vertex indices, ascending in each cell
+};
+
+// edge table of the model with coincident vertices welded, and the weld map. used by npSelectHole().
+struct npWeldedEdges
+{
+    int version = -1;
+    ConnectionData weld;
+    EdgeTable edges;
+};
+
+enum class npBrushFalloff
+{
+    Euclidean,  // distance from the brush center
+    Geodesic,   // distance along edges from the triangle at the brush center. doesn't leak across gaps
+};
+
+// state of the geodesic falloff kept between dabs
+struct npGeodesicFront
+{
+    GeodesicFront front; // over welded representatives
+
+    // front.settled is reused as is only if the next dab is at the same position with no larger radius.
+    // a moved dab shifts every distance by an amount that depends on the path (not bounded by the euclidean offset
+    // of the centers), so it gets a new search. only the search buffers carry over, so it costs the visited vertices.
+    int version = -1;
+    float4x4 transform = float4x4::identity();
+    float3 pos = float3::zero();
+    float radius = 0.0f;
+};
+
+// per-mesh acceleration structures. created by npCreateMeshCache() and held by managed side via npMeshData::cache.
+struct npMeshCache
+{
+    TriangleBVH bvh;
+    int version = 0; // incremented when vertices are modified
+
+    DepthBuffer depth;
+    int depth_version = -1;
+
+    PointGrid grid; // world space vertex positions
+    int grid_version = -1;
+    float4x4 grid_transform;
+
+    npSelectionIndex selection;
+    npScreenPositions screen;
+
+    EdgeTable edges;            // topology is assumed to be unchanged while the cache lives
+    npWeldedEdges welded_edges; // depends on vertex positions. rebuilt when vertices are modified
+
+    npBrushFalloff brush_falloff = npBrushFalloff::Euclidean;
+    npGeodesicFront geodesic;
+
+    npProjectionSource projection;
+};
 
 struct npMeshData
 {
@@ -14,8 +119,42 @@ struct npMeshData
     int         num_vertices = 0;
     int         num_triangles = 0;
     float4x4    transform = float4x4::identity();
+    npMeshCache *cache = nullptr;
 };
 
+// set of meshes for npRaycastScene(). bottom-level BVHs are the ones in npMeshCache.
+// meshes without cache get a BVH owned by the scene, which is refitted on every npUpdateScene() as they have no version.
+// scenes are registered so that npDestroyMeshCache() can drop the ones referencing the destroyed cache's BVH.
+struct npScene
+{
+    struct Instance
+    {
+        npMeshData model;
+        int version = 0;
+        std::unique_ptr<TriangleBVH> bvh;
+    };
+    std::vector<Instance> instances;
+    SceneBVH tlas;
+};
+
+static std::mutex g_scenes_mutex;
+static std::vector<npScene*> g_scenes;
+
+// scenes holding the cache's BVH are emptied. they are rebuilt by the next npUpdateScene().
+static void DropScenesReferencing(const npMeshCache *cache)
+{
+    std::unique_lock<std::mutex> lock(g_scenes_mutex);
+    for (auto *scene : g_scenes) {
+        auto& instances = scene->instances;
+        bool found = std::any_of(instances.begin(), instances.end(),
+            [cache](const npScene::Instance& inst) { return inst.model.cache == cache; });
+        if (found) {
+            instances.clear();
+            scene->tlas.clear();
+        }
+    }
+}
+
 struct npSkinData
 {
     Weights4    *weights = nullptr;
@@ -27,6 +166,15 @@ struct npSkinData
 };
 
 
+inline static int RaycastLocal(
+    const npMeshData& model, const float3 pos, const float3 dir, int& tindex, float& distance)
+{
+    if (model.cache && !model.cache->bvh.empty()) {
+        return model.cache->bvh.raycast(pos, dir, tindex, distance) ? 1 : 0;
+    }
+    return RayTrianglesIntersectionIndexed(pos, dir, model.vertices, model.indices, model.num_triangles, tindex, distance);
+}
+
 inline static int Raycast(
     const npMeshData& model, const float3 pos, const float3 dir, int& tindex, float& distance)
 {
@@ -34,7 +182,7 @@ inline static int Raycast(
     float3 rpos = mul_p(itrans, pos);
     float3 rdir = normalize(mul_v(itrans, dir));
     float d;
-    int hit = RayTrianglesIntersectionIndexed(rpos, rdir, model.vertices, model.indices, model.num_triangles, tindex, d);
+    int hit = RaycastLocal(model, rpos, rdir, tindex, d);
     if (hit) {
         float3 hpos = rpos + rdir * d;
         distance = length(mul_p(model.transform, hpos) - pos);
@@ -42,20 +190,423 @@ inline static int Raycast(
     return hit;
 }
 
-inline static int RaycastWithoutTransform(
-    const npMeshData& model, const float3 pos, const float3 dir, int& tindex, float& distance)
+// true if m consists of rotation, uniform scale and translation only. such transforms preserve which point is the nearest.
+static bool IsSimilarityTransform(const float4x4& m)
 {
-    float d;
-    int hit = RayTrianglesIntersectionIndexed(pos, dir, model.vertices, model.indices, model.num_triangles, tindex, d);
-    if (hit) {
-        float3 hpos = pos + dir * d;
-        distance = length(hpos - pos);
+    float3 c[3];
+    for (int i = 0; i < 3; ++i) {
+        c[i] = { m[i][0], m[i][1], m[i][2] };
     }
-    return hit;
+    float l = length_sq(c[0]);
+    float eps = l * 1e-4f;
+    return
+        near_equal(length_sq(c[1]), l, eps) && near_equal(length_sq(c[2]), l, eps) &&
+        std::abs(dot(c[0], c[1])) < eps && std::abs(dot(c[1], c[2])) < eps && std::abs(dot(c[2], c[0])) < eps;
 }
 
-#define npVertexBlockSize 1024
+// same result as TriangleBVH::closestPoint() without max distance
+static bool ClosestPointBruteForce(const float3 *vertices, const int *indices, int num_triangles, float3 pos, TriangleBVH::Hit& hit)
+{
+    float best = FLT_MAX;
+    hit.tindex = -1;
+    for (int ti = 0; ti < num_triangles; ++ti) {
+        float u, v;
+        float3 d = closest_point_on_triangle(pos,
+            vertices[indices[ti * 3 + 0]], vertices[indices[ti * 3 + 1]], vertices[indices[ti * 3 + 2]], u, v) - pos;
+        float dsq = dot(d, d);
+        if (dsq < best) {
+            best = dsq;
+            hit.tindex = ti;
+            hit.u = u;
+            hit.v = v;
+        }
+    }
+    if (hit.tindex == -1) { return false; }
+    hit.distance = std::sqrt(best);
+    return true;
+}
+
+// pos: model local space. visible[i] receives the result for targets[i].
+// a vertex is visible if nothing blocks the ray before it reaches the vertex. triangles that contain the vertex are ignored.
+static void TestVisibilityByRays(const npMeshData& model, const float3 pos, const RawVector<int>& targets, RawVector<bool>& visible)
+{
+    int num_targets = (int)targets.size();
+    RawVector<float3> rpos, rdir;
+    RawVector<float> max_distances;
+    rpos.resize_discard(num_targets);
+    rdir.resize_discard(num_targets);
+    max_distances.resize_discard(num_targets);
+    parallel_for(0, num_targets, [&](int i) {
+        float3 d = model.vertices[targets[i]] - pos;
+        float distance = length(d);
+        rpos[i] = pos;
+        rdir[i] = distance > 0.0f ? d / distance : float3{ 0.0f, 0.0f, 1.0f };
+        max_distances[i] = std::max(distance - 0.01f, 0.0f);
+    });
+
+    visible.resize_discard(num_targets);
+    if (model.cache && !model.cache->bvh.empty()) {
+        model.cache->bvh.occluded(rpos.data(), rdir.data(), max_distances.data(), targets.data(), num_targets,
+            model.indices, visible.data());
+        for (auto& v : visible) { v = !v; }
+    }
+    else {
+        parallel_for(0, num_targets, [&](int i) {
+            visible[i] = !RayTrianglesOcclusionIndexed(rpos[i], rdir[i], model.vertices, model.indices, model.num_triangles,
+                targets[i], max_distances[i]);
+        });
+    }
+}
+
+#define npDepthBufferPixels (1024 * 1024)
 
+// size of the depth buffer. the aspect ratio follows the viewport, which is the ratio of the scales of
+// clip space y and x in world space (same for perspective and orthographic projections).
+static void GetDepthBufferSize(const npMeshData& model, const float4x4& mvp, int& width, int& height)
+{
+    auto itrans = invert(model.transform);
+    float3 gx = { mvp[0][0], mvp[1][0], mvp[2][0] };
+    float3 gy = { mvp[0][1], mvp[1][1], mvp[2][1] };
+    auto to_world = [&](float3 g) {
+        return float3{ dot((float3&)itrans[0], g), dot((float3&)itrans[1], g), dot((float3&)itrans[2], g) };
+    };
+    float lx = length(to_world(gx)), ly = length(to_world(gy));
+    float aspect = lx > 0.0f && ly > 0.0f ? clamp(ly / lx, 1.0f / 16.0f, 16.0f) : 1.0f;
+    float s = std::sqrt((float)npDepthBufferPixels);
+    width = std::max((int)(s * std::sqrt(aspect)), 1);
+    height = std::max((int)(s / std::sqrt(aspect)), 1);
+}
+
+// depth buffer of the model seen through mvp. cached buffer is reused while mvp and vertices are unchanged.
+static const DepthBuffer& GetDepthBuffer(const npMeshData& model, const float4x4& mvp, const float3 pos, DepthBuffer& tmp)
+{
+    auto build = [&](DepthBuffer& dst) {
+        int width, height;
+        GetDepthBufferSize(model, mvp, width, height);
+        dst.build(mvp, pos,
+            IArray<int>(model.indices, model.num_triangles * 3),
+            IArray<float3>(model.vertices, model.num_vertices),
+            width, height);
+    };
+
+    auto *cache = model.cache;
+    if (!cache) {
+        build(tmp);
+        return tmp;
+    }
+    if (cache->depth.empty() || cache->depth_version != cache->version ||
+        memcmp(&cache->depth.mvp, &mvp, sizeof(float4x4)) != 0)
+    {
+        build(cache->depth);
+        cache->depth_version = cache->version;
+    }
+    return cache->depth;
+}
+
+// true if mvp is a perspective projection centered at pos, i.e. clip x, y and w of pos are zero within rounding errors.
+static bool IsProjectionCenter(const float4x4& mvp, float3 pos)
+{
+    float4 c = mul4(mvp, pos);
+    float4 s = { std::abs(mvp[3][0]), std::abs(mvp[3][1]), std::abs(mvp[3][2]), std::abs(mvp[3][3]) };
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 4; ++j) { s[j] += std::abs(mvp[i][j] * pos[i]); }
+    }
+    const float eps = 1e-4f;
+    return std::abs(c.x) <= s.x * eps && std::abs(c.y) <= s.y * eps && std::abs(c.w) <= s.w * eps;
+}
+
+// same results as TestVisibilityByRays() with the same ray-triangle test.
+// if mvp is a perspective projection centered at pos, the ray to a vertex projects to the vertex's pixel, so every
+// triangle that blocks it is binned in the pixel's tile of the depth buffer and only those are tested. the front-most
+// triangle of the pixel is tested first as it blocks the rays of most occluded vertices. vertices out of the screen
+// and all vertices of other projections (e.g. orthographic) are tested by rays.
+static void TestVisibility(const npMeshData& model, const float4x4& mvp, const float3 pos, const RawVector<int>& targets, RawVector<bool>& visible)
+{
+    if (!IsProjectionCenter(mvp, pos)) {
+        TestVisibilityByRays(model, pos, targets, visible);
+        return;
+    }
+
+    DepthBuffer tmp;
+    const auto& dbuf = GetDepthBuffer(model, mvp, pos, tmp);
+
+    auto indices = model.indices;
+    auto vertices = model.vertices;
+    int num_targets = (int)targets.size();
+
+    // 1: visible, 0: occluded, -1: undetermined
+    RawVector<char> state;
+    state.resize_discard(num_targets);
+    parallel_for_blocked(0, num_targets, npVertexBlockSize, [&](int i, int iend) {
+        for (; i < iend; ++i) {
+            int vi = targets[i];
+            float3 d = vertices[vi] - pos;
+            float distance = length(d);
+            float max_distance = std::max(distance - 0.01f, 0.0f);
+            float3 dir = distance > 0.0f ? d / distance : float3{ 0.0f, 0.0f, 1.0f };
+
+            auto blocks = [&](int ti) {
+                int i1 = indices[ti * 3 + 0];
+                int i2 = indices[ti * 3 + 1];
+                int i3 = indices[ti * 3 + 2];
+                if (i1 == vi || i2 == vi || i3 == vi) { return false; }
+                float t;
+                return ray_triangle_intersection(pos, dir, vertices[i1], vertices[i2], vertices[i3], t) && t < max_distance;
+            };
+
+            float4 vp = mul4(mvp, vertices[vi]);
+            int x, y;
+            if (!dbuf.getPixel(vp, x, y)) {
+                state[i] = -1;
+                continue;
+            }
+
+            int front = dbuf.getTriangle(x, y);
+            bool blocked = front >= 0 && blocks(front);
+
+            // w grows along the ray, so triangles whose nearest w is not less than the vertex's can't block it
+            const int *tris;
+            int num_tris = dbuf.getTileTriangles(x, y, tris);
+            for (int ti = 0; ti < num_tris && !blocked; ++ti) {
+                if (dbuf.near_w[tris[ti]] >= vp.w) { break; }
+                blocked = blocks(tris[ti]);
+            }
+            for (int ti : dbuf.near_triangles) {
+                if (blocked) { break; }
+                blocked = blocks(ti);
+            }
+            state[i] = blocked ? 0 : 1;
+        }
+    });
+
+    RawVector<int> rest;
+    for (int i = 0; i < num_targets; ++i) {
+        if (state[i] < 0) { rest.push_back(targets[i]); }
+    }
+    RawVector<bool> rest_visible;
+    if (!rest.empty()) {
+        TestVisibilityByRays(model, pos, rest, rest_visible);
+    }
+
+    visible.resize_discard(num_targets);
+    for (int i = 0, ri = 0; i < num_targets; ++i) {
+        visible[i] = state[i] < 0 ? rest_visible[ri++] : state[i] != 0;
+    }
+}
+
+// vertices projected by mvp. cached positions are reused while mvp and vertices are unchanged.
+static npScreenPositions& GetScreenPositions(const npMeshData& model, const float4x4& mvp, npScreenPositions& tmp)
+{
+    auto build = [&](npScreenPositions& dst) {
+        int num_vertices = model.num_vertices;
+        dst.x.resize_discard(num_vertices);
+        dst.y.resize_discard(num_vertices);
+        dst.z.resize_discard(num_vertices);
+        parallel_for_blocked(0, num_vertices, npVertexBlockSize, [&](int vi, int vend) {
+            ProjectPoints(mvp, model.vertices + vi,
+                &dst.x[vi], &dst.y[vi], &dst.z[vi], vend - vi);
+        });
+        dst.mvp = mvp;
+        dst.has_grid = false;
+    };
+
+    auto *cache = model.cache;
+    if (!cache) {
+        build(tmp);
+        return tmp;
+    }
+    auto& screen = cache->screen;
+    if (screen.version != cache->version || (int)screen.x.size() != model.num_vertices ||
+        memcmp(&screen.mvp, &mvp, sizeof(float4x4)) != 0)
+    {
+        build(screen);
+        screen.version = cache->version;
+    }
+    return screen;
+}
+
+#define npScreenGridSize 128
+
+// cell of the screen grid. cells cover [-1, 1] and positions out of it go to the border cells.
+static inline int GetScreenCell(float v)
+{
+    return std::min((int)((clamp(v, -1.0f, 1.0f) * 0.5f + 0.5f) * npScreenGridSize), npScreenGridSize - 1);
+}
+
+// screen positions bucketed into npScreenGridSize x npScreenGridSize cells. kept until positions are rebuilt.
+static const npScreenPositions& GetScreenGrid(npScreenPositions& screen)
+{
+    if (screen.has_grid) { return screen; }
+
+    int num_vertices = (int)screen.x.size();
+    RawVector<int> cells;
+    cells.resize_discard(num_vertices);
+    parallel_for_blocked(0, num_vertices, npVertexBlockSize, [&](int vi, int vend) {
+        for (; vi < vend; ++vi) {
+            float x = screen.x[vi], y = screen.y[vi];
+            // vertices behind the camera or with w = 0 can't be picked
+            if (screen.z[vi] > 0.0f && !std::isnan(x) && !std::isnan(y)) {
+                cells[vi] = GetScreenCell(y) * npScreenGridSize + GetScreenCell(x);
+            }
+            else {
+                cells[vi] = -1;
+            }
+        }
+    });
+
+    auto& offsets = screen.cell_offsets;
+    auto& vertices = screen.cell_vertices;
+    offsets.resize_zeroclear(npScreenGridSize * npScreenGridSize + 1);
+    for (int ci : cells) {
+        if (ci >= 0) { ++offsets[ci + 1]; }
+    }
+    for (int ci = 0; ci < npScreenGridSize * npScreenGridSize; ++ci) {
+        offsets[ci + 1] += offsets[ci];
+    }
+    vertices.resize_discard(offsets.back());
+    RawVector<int> pos;
+    pos.assign(offsets.begin(), offsets.end() - 1);
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        if (cells[vi] >= 0) { vertices[pos[cells[vi]]++] = vi; }
+    }
+    screen.has_grid = true;
+    return screen;
+}
+
+// exclude vertices that are not visible from campos (world space) from targets.
+static void ExcludeInvisible(const npMeshData& model, const float4x4& mvp, float3 campos, RawVector<int>& targets)
+{
+    if (targets.empty()) { return; }
+
+    RawVector<bool> visible;
+    TestVisibility(model, mvp, mul_p(invert(model.transform), campos), targets, visible);
+    int n = 0;
+    for (int i = 0; i < (int)targets.size(); ++i) {
+        if (visible[i]) { targets[n++] = targets[i]; }
+    }
+    targets.resize(n);
+}
+
+// gather vertices (in index order) whose screen position passes inside(float2 sp, float z).
+// sp is clip xy / w and z is clip space z. screen must be the positions projected by mvp.
+// if frontface_only, vertices that are not visible from campos are excluded.
+template<class Inside>
+static void GatherVerticesOnScreen(
+    const npMeshData& model, const float4x4& mvp, const npScreenPositions& screen, float3 campos, bool frontface_only,
+    const Inside& inside, RawVector<int>& dst)
+{
+    auto num_vertices = model.num_vertices;
+
+    RawVector<char> flags;
+    flags.resize_discard(num_vertices);
+    parallel_for_blocked(0, num_vertices, npVertexBlockSize, [&](int vi, int vend) {
+        for (; vi < vend; ++vi) {
+            flags[vi] = inside(float2{ screen.x[vi], screen.y[vi] }, screen.z[vi]) ? 1 : 0;
+        }
+    });
+
+    dst.clear();
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        if (flags[vi]) { dst.push_back(vi); }
+    }
+
+    if (frontface_only) {
+        ExcludeInvisible(model, mvp, campos, dst);
+    }
+}
+
+#define npMinVerticesForGrid 1024
+
+// grid of world space vertex positions. cached grid is rebuilt when vertices or the transform are changed.
+// returns nullptr if the model has no cache.
+static const PointGrid* GetVertexGrid(const npMeshData& model)
+{
+    auto *cache = model.cache;
+    if (!cache || model.num_vertices < npMinVerticesForGrid) { return nullptr; }
+
+    if (cache->grid.empty() || cache->grid_version != cache->version ||
+        memcmp(&cache->grid_transform, &model.transform, sizeof(float4x4)) != 0)
+    {
+        RawVector<float3> points;
+        points.resize_discard(model.num_vertices);
+        parallel_for_blocked(0, model.num_vertices, npVertexBlockSize, [&](int vi, int vend) {
+            for (; vi < vend; ++vi) {
+                points[vi] = mul_p(model.transform, model.vertices[vi]);
+            }
+        });
+        cache->grid.build(points);
+        cache->grid_version = cache->version;
+        cache->grid_transform = model.transform;
+    }
+    return &cache->grid;
+}
+
+// edges of the model. cached table is built on first use.
+static const EdgeTable& GetEdgeTable(const npMeshData& model, EdgeTable& tmp)
+{
+    auto *cache = model.cache;
+    auto& dst = cache ? cache->edges : tmp;
+    if (dst.empty() || dst.num_vertices != model.num_vertices) {
+        dst.build(IArray<int>(model.indices, model.num_triangles * 3), 3, model.num_vertices);
+    }
+    return dst;
+}
+
+// edges of the model with coincident vertices welded. cached table is rebuilt when vertices are modified.
+static const npWeldedEdges& GetWeldedEdges(const npMeshData& model, npWeldedEdges& tmp)
+{
+    auto *cache = model.cache;
+    auto& dst = cache ? cache->welded_edges : tmp;
+    int version = cache ? cache->version : 0;
+    if (dst.edges.empty() || dst.version != version || dst.edges.num_vertices != model.num_vertices) {
+        dst.weld.buildWeldMap(IArray<float3>(model.vertices, model.num_vertices));
+        dst.edges.buildWelded(IArray<int>(model.indices, model.num_triangles * 3), 3, dst.weld.weld_map);
+        dst.version = version;
+    }
+    return dst;
+}
+
+// welded vertices within geodesic distance radius from pos (world space). distances are measured along edges of
+// the welded mesh, starting from the corners of the triangle nearest to pos, by Dijkstra bounded by radius.
+// dst points to settled vertices in ascending order of distance. returns false if the model has no cache.
+static bool GatherInsideGeodesic(const npMeshData& model, float3 pos, float radius,
+    const std::pair<int, float>*& dst, int& num_dst)
+{
+    auto *cache = model.cache;
+    if (!cache || cache->bvh.empty()) { return false; }
+
+    auto& geodesic = cache->geodesic;
+    auto& front = geodesic.front;
+    if (geodesic.version != cache->version || geodesic.transform != model.transform || geodesic.pos != pos || geodesic.radius < radius) {
+        TriangleBVH::Hit hit;
+        if (!cache->bvh.closestPoint(mul_p(invert(model.transform), pos), FLT_MAX, hit)) { return false; }
+
+        auto& welded = GetWeldedEdges(model, cache->welded_edges);
+        auto *grid = GetVertexGrid(model);
+        int seeds[3];
+        for (int i = 0; i < 3; ++i) {
+            seeds[i] = welded.weld.weld_map[model.indices[hit.tindex * 3 + i]];
+        }
+        front.run(welded.edges, seeds, 3, pos, radius, [&](int vi) {
+            return grid ? grid->points[vi] : mul_p(model.transform, model.vertices[vi]);
+        });
+
+        geodesic.version = cache->version;
+        geodesic.transform = model.transform;
+        geodesic.pos = pos;
+        geodesic.radius = radius;
+    }
+
+    // settled vertices are sorted by distance, so the ones within radius are a prefix
+    auto& settled = front.settled;
+    dst = settled.data();
+    num_dst = (int)(std::upper_bound(settled.begin(), settled.end(), radius,
+        [](float r, const std::pair<int, float>& v) { return r < v.second; }) - settled.begin());
+    return true;
+}
+
+// calls body for vertices within the sphere (world space). body receives vertices in ascending index order unless parallel.
+// if the cache's falloff is geodesic, vertices within the geodesic distance are selected and d is the geodesic distance.
 template<class Body>
 inline static int SelectInside(const npMeshData& model, float3 pos, float radius, const Body& body, bool parallel = false)
 {
@@ -63,6 +614,60 @@ inline static int SelectInside(const npMeshData& model, float3 pos, float radius
     auto vertices = model.vertices;
     auto transform = model.transform;
 
+    const std::pair<int, float> *settled;
+    int num_settled;
+    if (model.cache && model.cache->brush_falloff == npBrushFalloff::Geodesic &&
+        GatherInsideGeodesic(model, pos, radius, settled, num_settled))
+    {
+        // expand welded representatives to their coincident vertices
+        auto& weld = model.cache->welded_edges.weld;
+        RawVector<std::pair<int, float>> inside;
+        for (int i = 0; i < num_settled; ++i) {
+            float d = settled[i].second;
+            weld.eachWeldedVertices(settled[i].first, [&](int vi) {
+                inside.push_back({ vi, d });
+            });
+        }
+        std::sort(inside.begin(), inside.end());
+
+        auto *grid = GetVertexGrid(model);
+        int num_inside = (int)inside.size();
+        auto do_select = [&](int i) {
+            int vi = inside[i].first;
+            body(vi, inside[i].second, grid ? grid->points[vi] : mul_p(transform, vertices[vi]));
+        };
+        if (parallel) {
+            parallel_for_blocked(0, num_inside, npVertexBlockSize, [&](int i, int iend) {
+                for (; i < iend; ++i) { do_select(i); }
+            });
+        }
+        else {
+            for (int i = 0; i < num_inside; ++i) { do_select(i); }
+        }
+        return num_inside;
+    }
+
+    if (auto *grid = GetVertexGrid(model)) {
+        // only vertices in cells overlapping the sphere are tested
+        RawVector<int> inside;
+        grid->gather(pos, radius, inside);
+        int num_inside = (int)inside.size();
+        auto do_select = [&](int i) {
+            int vi = inside[i];
+            float3 p = grid->points[vi];
+            body(vi, std::sqrt(length_sq(p - pos)), p);
+        };
+        if (parallel) {
+            parallel_for_blocked(0, num_inside, npVertexBlockSize, [&](int i, int iend) {
+                for (; i < iend; ++i) { do_select(i); }
+            });
+        }
+        else {
+            for (int i = 0; i < num_inside; ++i) { do_select(i); }
+        }
+        return num_inside;
+    }
+
     float rq = radius * radius;
     auto do_select = [&](int vi) -> bool {
         float3 p = mul_p(transform, vertices[vi]);
@@ -98,23 +703,230 @@ inline static int SelectInside(const npMeshData& model, float3 pos, float radius
     }
 }
 
+// sums of src[i] * selection[i] and selection[i] over vertices with selection > 0. returns the number of them.
+// blocks are summed in parallel and combined in order, so the result doesn't depend on the number of threads.
+static int SumSelected(const float3 *src, const float *selection, int num_vertices, double3& dst_sum, double& dst_weight)
+{
+    struct BlockSum
+    {
+        float3 sum;
+        float weight;
+        int count;
+    };
+    int num_blocks = ceildiv(num_vertices, npVertexBlockSize);
+    RawVector<BlockSum> blocks;
+    blocks.resize_discard(num_blocks);
+    parallel_for(0, num_blocks, [&](int bi) {
+        int begin = bi * npVertexBlockSize;
+        int n = std::min(npVertexBlockSize, num_vertices - begin);
+        auto& b = blocks[bi];
+        b.count = WeightedSum(src + begin, selection + begin, n, b.sum, b.weight);
+    });
+
+    double3 sum = double3::zero();
+    double weight = 0.0;
+    int count = 0;
+    for (auto& b : blocks) {
+        sum += double3{ b.sum.x, b.sum.y, b.sum.z };
+        weight += b.weight;
+        count += b.count;
+    }
+    dst_sum = sum;
+    dst_weight = weight;
+    return count;
+}
+
+// returns nullptr if the model has no cache. rebuilt if invalidated or the selection array is changed.
+static npSelectionIndex* GetSelectionIndex(const npMeshData& model)
+{
+    auto *cache = model.cache;
+    if (!cache || !model.selection) { return nullptr; }
+
+    auto& index = cache->selection;
+    if (!index.valid || index.selection != model.selection || index.num_vertices != model.num_vertices) {
+        auto num_vertices = model.num_vertices;
+        auto selection = model.selection;
+        int num_blocks = ceildiv(num_vertices, npVertexBlockSize);
+
+        // count selected vertices of each block, then fill in ascending order
+        RawVector<int> offsets;
+        offsets.resize_discard(num_blocks + 1);
+        parallel_for(0, num_blocks, [&](int bi) {
+            int vi = bi * npVertexBlockSize;
+            int vend = std::min(vi + npVertexBlockSize, num_vertices);
+            int n = 0;
+            for (; vi < vend; ++vi) {
+                if (selection[vi] != 0.0f) { ++n; }
+            }
+            offsets[bi + 1] = n;
+        });
+        offsets[0] = 0;
+        for (int bi = 0; bi < num_blocks; ++bi) {
+            offsets[bi + 1] += offsets[bi];
+        }
+
+        index.active.resize_discard(offsets[num_blocks]);
+        index.positions.resize_discard(num_vertices);
+        parallel_for(0, num_blocks, [&](int bi) {
+            int vi = bi * npVertexBlockSize;
+            int vend = std::min(vi + npVertexBlockSize, num_vertices);
+            int n = offsets[bi];
+            for (; vi < vend; ++vi) {
+                if (selection[vi] != 0.0f) {
+                    index.active[n] = vi;
+                    index.positions[vi] = n++;
+                }
+                else {
+                    index.positions[vi] = -1;
+                }
+            }
+        });
+        index.selection = selection;
+        index.num_vertices = num_vertices;
+        index.valid = true;
+        index.sorted = true;
+        index.stats_version = -1;
+    }
+    return &index;
+}
+
+// index with up-to-date sums. returns nullptr if the model has no cache.
+static npSelectionIndex* GetSelectionStats(const npMeshData& model)
+{
+    auto *index = GetSelectionIndex(model);
+    if (!index || index->stats_version == model.cache->version) { return index; }
+
+    if (index->active.size() * 8 < (size_t)model.num_vertices) {
+        auto vertices = model.vertices;
+        auto selection = model.selection;
+        int count = 0;
+        double weight = 0.0;
+        double3 sum = double3::zero();
+        for (int vi : index->active) {
+            float s = selection[vi];
+            if (s > 0.0f) {
+                float3 p = vertices[vi] * s;
+                sum += double3{ p.x, p.y, p.z };
+                weight += s;
+                ++count;
+            }
+        }
+        index->num_selected = count;
+        index->weight = weight;
+        index->weighted_pos = sum;
+    }
+    else {
+        index->num_selected = SumSelected(model.vertices, model.selection, model.num_vertices, index->weighted_pos, index->weight);
+    }
+    index->stats_version = model.cache->version;
+    return index;
+}
+
+// must be called after selection[vi] is modified. prev: selection[vi] before the modification.
+static inline void UpdateSelectionIndex(const npMeshData& model, int vi, float prev)
+{
+    auto *cache = model.cache;
+    if (!cache || !cache->selection.valid) { return; }
+
+    auto& index = cache->selection;
+    if (index.selection != model.selection || index.num_vertices != model.num_vertices) {
+        index.valid = false;
+        return;
+    }
+
+    float s = model.selection[vi];
+    if (index.stats_version == model.cache->version) {
+        float d = (s > 0.0f ? s : 0.0f) - (prev > 0.0f ? prev : 0.0f);
+        if (d != 0.0f) {
+            float3 p = model.vertices[vi] * d;
+            index.num_selected += (s > 0.0f ? 1 : 0) - (prev > 0.0f ? 1 : 0);
+            index.weight += d;
+            index.weighted_pos += double3{ p.x, p.y, p.z };
+            if (index.num_selected == 0) {
+                // discard accumulated rounding errors
+                index.weight = 0.0;
+                index.weighted_pos = double3::zero();
+            }
+        }
+    }
+
+    int& pos = index.positions[vi];
+    if (s != 0.0f) {
+        if (pos == -1) {
+            pos = (int)index.active.size();
+            index.active.push_back(vi);
+            index.sorted = false;
+        }
+    }
+    else if (pos != -1) {
+        int last = index.active.back();
+        index.active[pos] = last;
+        index.positions[last] = pos;
+        index.active.pop_back();
+        pos = -1;
+        index.sorted = false;
+    }
+}
+
+static inline void InvalidateSelectionIndex(const npMeshData& model)
+{
+    if (model.cache) { model.cache->selection.valid = false; }
+}
+
+// calls body(vi, s) for vertices with non-zero selection in ascending index order.
+// only selected vertices are visited if the model has cache.
+template<class Body>
+static inline void EachSelected(const npMeshData& model, const Body& body)
+{
+    auto selection = model.selection;
+    if (auto *index = GetSelectionIndex(model)) {
+        if (!index->sorted) {
+            auto& active = index->active;
+            std::sort(active.begin(), active.end());
+            for (int i = 0; i < (int)active.size(); ++i) {
+                index->positions[active[i]] = i;
+            }
+            index->sorted = true;
+        }
+        for (int vi : index->active) {
+            body(vi, selection[vi]);
+        }
+    }
+    else {
+        auto num_vertices = model.num_vertices;
+        for (int vi = 0; vi < num_vertices; ++vi) {
+            float s = selection[vi];
+            if (s != 0.0f) {
+                body(vi, s);
+            }
+        }
+    }
+}
+
 static bool GetFurthestDistance(const npMeshData& model, float3 pos, bool mask, int &vidx, float &dist)
 {
     auto num_vertices = model.num_vertices;
     auto vertices = model.vertices;
-    auto selection = model.selection;
 
     float furthest_sq = FLT_MIN;
     int furthest_vi;
 
     float3 lpos = mul_p(invert(model.transform), pos);
-    for (int vi = 0; vi < num_vertices; ++vi) {
-        if (!mask || selection[vi] > 0.0f) {
-            float dsq = length_sq(vertices[vi] - lpos);
-            if (dsq > furthest_sq) {
-                furthest_sq = dsq;
-                furthest_vi = vi;
-            }
+    auto check = [&](int vi) {
+        float dsq = length_sq(vertices[vi] - lpos);
+        if (dsq > furthest_sq) {
+            furthest_sq = dsq;
+            furthest_vi = vi;
+        }
+    };
+    if (mask) {
+        EachSelected(model, [&](int vi, float s) {
+            if (s > 0.0f) { check(vi); }
+        });
+    }
+    else {
+        for (int vi = 0; vi < num_vertices; ++vi) {
+            check(vi);
         }
     }
 
@@ -136,12 +948,188 @@ static inline float GetBrushSample(float distance, float bradius, float bsamples
 }
 
 
+npAPI npMeshCache* npCreateMeshCache(npMeshData *model)
+{
+    auto *ret = new npMeshCache();
+    ret->bvh.build(
+        IArray<int>(model->indices, model->num_triangles * 3),
+        IArray<float3>(model->vertices, model->num_vertices));
+    return ret;
+}
+
+// must be called when vertices are modified (e.g. skinning). topology must be unchanged.
+npAPI void npRefitMeshCache(npMeshData *model)
+{
+    if (!model->cache) { return; }
+    model->cache->bvh.refit(
+        IArray<int>(model->indices, model->num_triangles * 3),
+        IArray<float3>(model->vertices, model->num_vertices));
+    ++model->cache->version;
+}
+
+npAPI void npDestroyMeshCache(npMeshCache *cache)
+{
+    DropScenesReferencing(cache);
+    delete cache;
+}
+
+// falloff of brushes (npSelectBrush() and npBrush*()). 0: euclidean, 1: geodesic. geodesic falloff requires cache.
+npAPI void npSetBrushFalloff(npMeshData *model, int falloff)
+{
+    if (!model->cache) { return; }
+    model->cache->brush_falloff = (npBrushFalloff)falloff;
+}
+
+// must be called when selection is modified by the managed side
+npAPI void npResetSelectionIndex(npMeshData *model)
+{
+    InvalidateSelectionIndex(*model);
+}
+
 npAPI int npRaycast(
     npMeshData *model, const float3 pos, const float3 dir, int *tindex, float *distance)
 {
     return Raycast(*model, pos, dir, *tindex, *distance);
 }
 
+npAPI npScene* npCreateScene()
+{
+    auto *ret = new npScene();
+    std::unique_lock<std::mutex> lock(g_scenes_mutex);
+    g_scenes.push_back(ret);
+    return ret;
+}
+
+npAPI void npDestroyScene(npScene *scene)
+{
+    {
+        std::unique_lock<std::mutex> lock(g_scenes_mutex);
+        g_scenes.erase(std::remove(g_scenes.begin(), g_scenes.end(), scene), g_scenes.end());
+    }
+    delete scene;
+}
+
+// sets meshes of the scene. the top-level tree is rebuilt if meshes are added, removed or replaced.
+// otherwise it is only refitted to the new transforms, BVHs refitted by npRefitMeshCache() and the scene-owned BVHs.
+npAPI void npUpdateScene(npScene *scene, npMeshData models[], int num_models)
+{
+    auto& instances = scene->instances;
+    bool rebuild = instances.size() != (size_t)num_models;
+    for (int i = 0; i < num_models && !rebuild; ++i) {
+        auto& a = instances[i].model;
+        auto& b = models[i];
+        rebuild = a.indices != b.indices || a.vertices != b.vertices || a.num_triangles != b.num_triangles ||
+            a.num_vertices != b.num_vertices || a.cache != b.cache;
+    }
+
+    if (rebuild) {
+        instances.resize(num_models);
+        parallel_for(0, num_models, [&](int i) {
+            auto& inst = instances[i];
+            auto& model = models[i];
+            inst.model = model;
+            inst.version = model.cache ? model.cache->version : 0;
+            inst.bvh.reset();
+            if (!model.cache) {
+                inst.bvh.reset(new TriangleBVH());
+                inst.bvh->build(
+                    IArray<int>(model.indices, model.num_triangles * 3),
+                    IArray<float3>(model.vertices, model.num_vertices));
+            }
+        });
+    }
+
+    bool refit = false;
+    RawVector<const TriangleBVH*> blas;
+    RawVector<float4x4> transforms;
+    blas.resize_discard(num_models);
+    transforms.resize_discard(num_models);
+    for (int i = 0; i < num_models; ++i) {
+        auto& inst = instances[i];
+        auto& model = models[i];
+        if (memcmp(&inst.model.transform, &model.transform, sizeof(float4x4)) != 0 ||
+            (model.cache && inst.version != model.cache->version))
+        {
+            refit = true;
+        }
+        if (!rebuild && inst.bvh) {
+            inst.bvh->refit(
+                IArray<int>(model.indices, model.num_triangles * 3),
+                IArray<float3>(model.vertices, model.num_vertices));
+            refit = true;
+        }
+        inst.model = model;
+        inst.version = model.cache ? model.cache->version : 0;
+        blas[i] = model.cache ? &model.cache->bvh : inst.bvh.get();
+        transforms[i] = model.transform;
+    }
+
+    if (rebuild) {
+        scene->tlas.build(blas.data(), transforms.data(), num_models);
+    }
+    else if (refit) {
+        scene->tlas.refit(transforms.data());
+    }
+}
+
+// nearest hit among meshes of the scene. pos, dir and distance are in world space.
+npAPI int npRaycastScene(
+    npScene *scene, const float3 pos, const float3 dir, int *instance, int *tindex, float *distance)
+{
+    SceneBVH::Hit hit;
+    if (!scene->tlas.raycast(pos, normalize(dir), hit)) { return 0; }
+    *instance = hit.instance;
+    *tindex = hit.tindex;
+    *distance = hit.distance;
+    return 1;
+}
+
+// nearest point on the model's surface from pos. pos and point are in world space.
+npAPI int npClosestPoint(
+    npMeshData *model, const float3 pos, int *tindex, float3 *point, float *distance)
+{
+    auto& trans = model->transform;
+    auto vertices = model->vertices;
+    auto indices = model->indices;
+
+    TriangleBVH::Hit hit;
+    bool found;
+    if (IsSimilarityTransform(trans)) {
+        float3 lpos = mul_p(invert(trans), pos);
+        if (model->cache && !model->cache->bvh.empty()) {
+            found = model->cache->bvh.closestPoint(lpos, FLT_MAX, hit);
+        }
+        else {
+            found = ClosestPointBruteForce(vertices, indices, model->num_triangles, lpos, hit);
+        }
+    }
+    else if (model->cache && !model->cache->bvh.empty()) {
+        // non-uniform scale or shear changes which point is the nearest. search in world space with the local BVH.
+        found = model->cache->bvh.closestPoint(pos, trans, FLT_MAX, hit);
+    }
+    else {
+        RawVector<float3> wvertices;
+        wvertices.resize_discard(model->num_vertices);
+        parallel_for_blocked(0, model->num_vertices, npVertexBlockSize, [&](int vi, int vend) {
+            for (; vi < vend; ++vi) {
+                wvertices[vi] = mul_p(trans, vertices[vi]);
+            }
+        });
+        found = ClosestPointBruteForce(wvertices.data(), indices, model->num_triangles, pos, hit);
+    }
+    if (!found) { return 0; }
+
+    int ti = hit.tindex;
+    float3 p1 = vertices[indices[ti * 3 + 0]];
+    float3 p2 = vertices[indices[ti * 3 + 1]];
+    float3 p3 = vertices[indices[ti * 3 + 2]];
+    float3 wpoint = mul_p(trans, p1 + (p2 - p1) * hit.u + (p3 - p1) * hit.v);
+    *tindex = ti;
+    *point = wpoint;
+    *distance = length(wpoint - pos);
+    return 1;
+}
+
 npAPI float3 npPickNormal(
     npMeshData *model, const float3 pos, int ti)
 {
@@ -159,7 +1147,6 @@ npAPI float3 npPickNormal(
 npAPI int npSelectSingle(
     npMeshData *model, const float4x4 *mvp_, float2 rmin, float2 rmax, float3 campos, float strength, int frontface_only)
 {
-    auto num_vertices = model->num_vertices;
     auto vertices = model->vertices;
     auto normals = model->normals;
     auto selection = model->selection;
@@ -168,82 +1155,85 @@ npAPI int npSelectSingle(
     float3 lcampos = mul_p(invert(model->transform), campos);
     float2 rcenter = (rmin + rmax) * 0.5f;
 
-    const int max_inside = 64;
-    std::pair<int, float> insider[max_inside];
-    int num_inside = 0;
+    auto in_rect = [&](float2 sp, float z) {
+        return sp.x >= rmin.x && sp.x <= rmax.x &&
+            sp.y >= rmin.y && sp.y <= rmax.y && z > 0.0f;
+    };
 
-    {
-        // gather vertices inside rect
-        std::atomic_int num_inside_a{ 0 };
-        parallel_for(0, num_vertices, [&](int vi) {
-            float4 vp = mul4(mvp, vertices[vi]);
-            float2 sp = float2{ vp.x, vp.y } / vp.w;
-            if (sp.x >= rmin.x && sp.x <= rmax.x &&
-                sp.y >= rmin.y && sp.y <= rmax.y && vp.z > 0.0f)
-            {
-                bool hit = false;
-                if (frontface_only) {
-                    float3 vpos = vertices[vi];
-                    float3 dir = normalize(vpos - lcampos);
-                    int ti;
-                    float distance;
-                    if (RaycastWithoutTransform(*model, lcampos, dir, ti, distance)) {
-                        float3 hitpos = lcampos + dir * distance;
-                        if (length(vpos - hitpos) < 0.01f) {
-                            hit = true;
-                        }
+    // gather vertices inside rect
+    npScreenPositions tmp;
+    auto& screen = GetScreenPositions(*model, mvp, tmp);
+    RawVector<int> insider;
+    if (model->cache) {
+        // only cells overlapping the rect are searched. the grid is kept in the cache while mvp is unchanged.
+        const auto& grid = GetScreenGrid(screen);
+        int cx0 = GetScreenCell(rmin.x), cx1 = GetScreenCell(rmax.x);
+        int cy0 = GetScreenCell(rmin.y), cy1 = GetScreenCell(rmax.y);
+        for (int cy = cy0; cy <= cy1; ++cy) {
+            for (int cx = cx0; cx <= cx1; ++cx) {
+                int ci = cy * npScreenGridSize + cx;
+                for (int i = grid.cell_offsets[ci]; i < grid.cell_offsets[ci + 1]; ++i) {
+                    int vi = grid.cell_vertices[i];
+                    if (in_rect(float2{ screen.x[vi], screen.y[vi] }, screen.z[vi])) {
+                        insider.push_back(vi);
                     }
                 }
-                else {
-                    hit = true;
-                }
+            }
+        }
+        std::sort(insider.begin(), insider.end());
+        if (frontface_only) {
+            ExcludeInvisible(*model, mvp, campos, insider);
+        }
+    }
+    else {
+        GatherVerticesOnScreen(*model, mvp, screen, campos, frontface_only != 0, in_rect, insider);
+    }
 
-                if (hit) {
-                    int ii = num_inside_a++;
-                    if (ii < max_inside) {
-                        insider[ii].first = vi;
-                        insider[ii].second = length(sp - rcenter);
-                    }
-                }
+    if (!insider.empty()) {
+        // search nearest from center of rect.
+        // distances and facings are computed in parallel, but the search is serial in index order as near_equal()
+        // is not transitive and merging per block results could pick a different vertex.
+        int num_insider = (int)insider.size();
+        RawVector<float> distances, facings;
+        distances.resize_discard(num_insider);
+        facings.resize_discard(num_insider);
+        parallel_for_blocked(0, num_insider, npVertexBlockSize, [&](int i, int iend) {
+            for (; i < iend; ++i) {
+                int vi = insider[i];
+                distances[i] = length(float2{ screen.x[vi], screen.y[vi] } - rcenter);
+                facings[i] = dot(normals[vi], normalize(vertices[vi] - lcampos));
             }
         });
-        num_inside = std::min<int>(num_inside_a, max_inside);
-    }
 
-    if (num_inside > 0) {
-        // search nearest from center of rect
         int nearest_index = 0;
         float nearest_distance = FLT_MAX;
         float nearest_facing = 1.0f;
+        for (int i = 0; i < num_insider; ++i) {
+            float distance = distances[i];
 
-        for (int ii = 0; ii < num_inside; ++ii) {
-            int vi = insider[ii].first;
-            float distance = insider[ii].second;
-            float3 dir = normalize(vertices[vi] - lcampos);
-            
-            // if there are vertices with identical position, pick most camera-facing one 
+            // if there are vertices with identical position, pick most camera-facing one
             if (near_equal(distance, nearest_distance, npEpsilon)) {
-                float facing = dot(normals[vi], dir);
-                if (facing < nearest_facing) {
-                    nearest_index = vi;
+                if (facings[i] < nearest_facing) {
+                    nearest_index = insider[i];
                     nearest_distance = distance;
-                    nearest_facing = facing;
+                    nearest_facing = facings[i];
                 }
             }
             else if (distance < nearest_distance) {
-                nearest_index = vi;
+                nearest_index = insider[i];
                 nearest_distance = distance;
-                nearest_facing = dot(normals[vi], dir);
+                nearest_facing = facings[i];
             }
         }
 
-        selection[nearest_index] = clamp01(selection[nearest_index] + strength);
+        float prev = selection[nearest_index];
+        selection[nearest_index] = clamp01(prev + strength);
+        UpdateSelectionIndex(*model, nearest_index, prev);
         return 1;
     }
     return 0;
 }
 
-
 npAPI int npSelectTriangle(
     npMeshData *model, const float3 pos, const float3 dir, float strength)
 {
@@ -254,7 +1244,10 @@ npAPI int npSelectTriangle(
     float distance;
     if (Raycast(*model, pos, dir, ti, distance)) {
         for (int i = 0; i < 3; ++i) {
-            selection[indices[ti * 3 + i]] = clamp01(selection[indices[ti * 3 + i]] + strength);
+            int vi = indices[ti * 3 + i];
+            float prev = selection[vi];
+            selection[vi] = clamp01(prev + strength);
+            UpdateSelectionIndex(*model, vi, prev);
         }
         return 1;
     }
@@ -264,19 +1257,16 @@ npAPI int npSelectTriangle(
 npAPI int npSelectEdge(
     npMeshData *model, float strength, int clear, int mask)
 {
-    auto indices = IArray<int>(model->indices, model->num_triangles * 3);
-    auto vertices = IArray<float3>(model->vertices, model->num_vertices);
     auto selection = model->selection;
     int num_vertices = model->num_vertices;
 
     RawVector<int> targets;
     if (mask) {
-        targets.reserve(num_vertices);
-        for (int vi = 0; vi < num_vertices; ++vi) {
-            if (selection[vi] > 0.0f) {
+        EachSelected(*model, [&](int vi, float s) {
+            if (s > 0.0f) {
                 targets.push_back(vi);
             }
-        }
+        });
     }
     else {
         targets.resize(num_vertices);
@@ -285,11 +1275,17 @@ npAPI int npSelectEdge(
         }
     }
 
-    if (clear) { memset(selection, 0, num_vertices * 4); }
+    if (clear) {
+        memset(selection, 0, num_vertices * 4);
+        InvalidateSelectionIndex(*model);
+    }
 
+    EdgeTable tmp;
     int ret = 0;
-    SelectEdge(indices, 3, vertices, targets, [&](int vi) {
-        selection[vi] = clamp01(selection[vi] + strength);
+    SelectEdge(GetEdgeTable(*model, tmp), targets, [&](int vi) {
+        float prev = selection[vi];
+        selection[vi] = clamp01(prev + strength);
+        UpdateSelectionIndex(*model, vi, prev);
         ++ret;
     });
     return ret;
@@ -298,19 +1294,16 @@ npAPI int npSelectEdge(
 npAPI int npSelectHole(
     npMeshData *model, float strength, int clear, int mask)
 {
-    auto indices = IArray<int>(model->indices, model->num_triangles * 3);
-    auto vertices = IArray<float3>(model->vertices, model->num_vertices);
     auto selection = model->selection;
     int num_vertices = model->num_vertices;
 
     RawVector<int> targets;
     if (mask) {
-        targets.reserve(num_vertices);
-        for (int vi = 0; vi < num_vertices; ++vi) {
-            if (selection[vi] > 0.0f) {
+        EachSelected(*model, [&](int vi, float s) {
+            if (s > 0.0f) {
                 targets.push_back(vi);
             }
-        }
+        });
     }
     else {
         targets.resize(num_vertices);
@@ -319,11 +1312,18 @@ npAPI int npSelectHole(
         }
     }
 
-    if (clear) { memset(selection, 0, num_vertices * 4); }
+    if (clear) {
+        memset(selection, 0, num_vertices * 4);
+        InvalidateSelectionIndex(*model);
+    }
 
+    npWeldedEdges tmp;
+    const auto& welded = GetWeldedEdges(*model, tmp);
     int ret = 0;
-    SelectHole(indices, 3, vertices, targets, [&](int vi) {
-        selection[vi] = clamp01(selection[vi] + strength);
+    SelectHole(welded.edges, welded.weld, targets, [&](int vi) {
+        float prev = selection[vi];
+        selection[vi] = clamp01(prev + strength);
+        UpdateSelectionIndex(*model, vi, prev);
         ++ret;
     });
     return ret;
@@ -332,26 +1332,42 @@ npAPI int npSelectHole(
 npAPI int npSelectConnected(
     npMeshData *model, float strength, int clear)
 {
-    auto indices = IArray<int>(model->indices, model->num_triangles * 3);
-    auto vertices = IArray<float3>(model->vertices, model->num_vertices);
     auto selection = model->selection;
     int num_vertices = model->num_vertices;
 
-    RawVector<int> targets;
-    targets.reserve(num_vertices);
-    for (int vi = 0; vi < num_vertices; ++vi) {
-        if (selection[vi] > 0.0f) {
-            targets.push_back(vi);
+    EdgeTable tmp;
+    const auto& edges = GetEdgeTable(*model, tmp);
+
+    // components that contain selected vertices
+    RawVector<bool> targets;
+    targets.resize_zeroclear(edges.numComponents());
+    int num_targets = 0;
+    EachSelected(*model, [&](int vi, float s) {
+        if (s > 0.0f && !targets[edges.vertex_components[vi]]) {
+            targets[edges.vertex_components[vi]] = true;
+            ++num_targets;
         }
-    }
+    });
 
-    if (clear) { memset(selection, 0, num_vertices * 4); }
+    if (clear) {
+        memset(selection, 0, num_vertices * 4);
+        InvalidateSelectionIndex(*model);
+    }
+    if (num_targets == 0) { return 0; }
 
-    int ret = 0;
-    SelectConnected(indices, 3, vertices, targets, [&](int vi) {
-        selection[vi] = clamp01(selection[vi] + strength);
-        ++ret;
+    // select all vertices of the components in one pass. the selection index is rebuilt on demand.
+    std::atomic_int ret{ 0 };
+    parallel_for_blocked(0, num_vertices, npVertexBlockSize, [&](int vi, int vend) {
+        int n = 0;
+        for (; vi < vend; ++vi) {
+            if (targets[edges.vertex_components[vi]]) {
+                selection[vi] = clamp01(selection[vi] + strength);
+                ++n;
+            }
+        }
+        ret += n;
     });
+    InvalidateSelectionIndex(*model);
     return ret;
 }
 
@@ -359,108 +1375,51 @@ npAPI int npSelectRect(
     npMeshData *model,
     const float4x4 *mvp_, float2 rmin, float2 rmax, float3 campos, float strength, int frontface_only)
 {
-    auto num_vertices = model->num_vertices;
-    auto vertices = model->vertices;
-    auto normals = model->normals;
     auto selection = model->selection;
 
-    float4x4 mvp = *mvp_;
-    float3 lcampos = mul_p(invert(model->transform), campos);
-
-    std::atomic_int ret{ 0 };
-    parallel_for_blocked(0, num_vertices, npVertexBlockSize, [&](int vi, int vend) {
-        int c = 0;
-        for (; vi < vend; ++vi) {
-            float4 vp = mul4(mvp, vertices[vi]);
-            float2 sp = float2{ vp.x, vp.y } / vp.w;
-            if (sp.x >= rmin.x && sp.x <= rmax.x &&
-                sp.y >= rmin.y && sp.y <= rmax.y && vp.z > 0.0f)
-            {
-                bool hit = false;
-                if (frontface_only) {
-                    float3 vpos = vertices[vi];
-                    float3 dir = normalize(vpos - lcampos);
-                    int ti;
-                    float distance;
-                    if (RaycastWithoutTransform(*model, lcampos, dir, ti, distance)) {
-                        float3 hitpos = lcampos + dir * distance;
-                        if (length(vpos - hitpos) < 0.01f) {
-                            hit = true;
-                        }
-                    }
-                }
-                else {
-                    hit = true;
-                }
-
-                if (hit) {
-                    selection[vi] = clamp01(selection[vi] + strength);
-                    ++c;
-                }
-            }
-        }
-        ret += c;
-    });
-    return ret;
+    npScreenPositions tmp;
+    const auto& screen = GetScreenPositions(*model, *mvp_, tmp);
+    RawVector<int> targets;
+    GatherVerticesOnScreen(*model, *mvp_, screen, campos, frontface_only != 0, [&](float2 sp, float z) {
+        return sp.x >= rmin.x && sp.x <= rmax.x &&
+            sp.y >= rmin.y && sp.y <= rmax.y && z > 0.0f;
+    }, targets);
+
+    for (int vi : targets) {
+        float prev = selection[vi];
+        selection[vi] = clamp01(prev + strength);
+        UpdateSelectionIndex(*model, vi, prev);
+    }
+    return (int)targets.size();
 }
 
+#define npLassoMaskResolution 1024
+
 npAPI int npSelectLasso(
     npMeshData *model,
     const float4x4 *mvp_, const float2 lasso[], int num_lasso_points, float3 campos, float strength, int frontface_only)
 {
     if (num_lasso_points < 3) { return 0; }
 
-    auto num_vertices = model->num_vertices;
-    auto vertices = model->vertices;
-    auto normals = model->normals;
     auto selection = model->selection;
 
-    float4x4 mvp = *mvp_;
-    float3 lcampos = mul_p(invert(model->transform), campos);
-
-    float2 minp, maxp;
-    MinMax(lasso, num_lasso_points, minp, maxp);
+    // most vertices are classified by one lookup. only ones near the lasso line need the exact test.
+    PolygonMask mask;
+    mask.build(lasso, num_lasso_points, npLassoMaskResolution);
 
-    RawVector<float> polyx, polyy;
-    polyx.resize(num_lasso_points); polyy.resize(num_lasso_points);
-    for (int i = 0; i < num_lasso_points; ++i) {
-        polyx[i] = lasso[i].x;
-        polyy[i] = lasso[i].y;
+    npScreenPositions tmp;
+    const auto& screen = GetScreenPositions(*model, *mvp_, tmp);
+    RawVector<int> targets;
+    GatherVerticesOnScreen(*model, *mvp_, screen, campos, frontface_only != 0, [&](float2 sp, float) {
+        return mask.inside(sp);
+    }, targets);
+
+    for (int vi : targets) {
+        float prev = selection[vi];
+        selection[vi] = clamp01(prev + strength);
+        UpdateSelectionIndex(*model, vi, prev);
     }
-
-    std::atomic_int ret{ 0 };
-    parallel_for_blocked(0, num_vertices, npVertexBlockSize, [&](int vi, int vend) {
-        int c = 0;
-        for (; vi < vend; ++vi) {
-            float4 vp = mul4(mvp, vertices[vi]);
-            float2 sp = float2{ vp.x, vp.y } / vp.w;
-            if (PolyInside(polyx.data(), polyy.data(), num_lasso_points, minp, maxp, sp)) {
-                bool hit = false;
-                if (frontface_only) {
-                    float3 vpos = vertices[vi];
-                    float3 dir = normalize(vpos - lcampos);
-                    int ti;
-                    float distance;
-                    if (RaycastWithoutTransform(*model, lcampos, dir, ti, distance)) {
-                        float3 hitpos = lcampos + dir * distance;
-                        if (length(vpos - hitpos) < 0.01f) {
-                            hit = true;
-                        }
-                    }
-                }
-                else {
-                    hit = true;
-                }
-
-                if (hit) {
-                    selection[vi] = clamp01(selection[vi] + strength);
-                    ++c;
-                }
-            }
-        }
-        ret += c;
-    });
-    return ret;
+    return (int)targets.size();
 }
 
 npAPI int npSelectBrush(
@@ -469,10 +1428,30 @@ npAPI int npSelectBrush(
 {
     auto selection = model->selection;
 
-    return SelectInside(*model, pos, radius, [&](int vi, float d, float3 p) {
+    // weights are applied in parallel. the index can't be updated in parallel, so the previous values are recorded
+    // and the index is updated afterwards in ascending order of vertices (same order as the serial selection).
+    bool update_index = model->cache && model->cache->selection.valid;
+    tls<RawVector<std::pair<int, float>>> changes;
+    int ret = SelectInside(*model, pos, radius, [&](int vi, float d, float3 p) {
         float s = GetBrushSample(d, radius, bsamples, num_bsamples) * strength;
-        selection[vi] = clamp01(selection[vi] + s);
+        float prev = selection[vi];
+        selection[vi] = clamp01(prev + s);
+        if (update_index) {
+            changes.local().push_back({ vi, prev });
+        }
     }, true);
+
+    if (update_index) {
+        RawVector<std::pair<int, float>> all;
+        changes.each([&](RawVector<std::pair<int, float>>& c) {
+            for (auto& v : c) { all.push_back(v); }
+        });
+        std::sort(all.begin(), all.end());
+        for (auto& v : all) {
+            UpdateSelectionIndex(*model, v.first, v.second);
+        }
+    }
+    return ret;
 }
 
 npAPI int npUpdateSelection(
@@ -480,36 +1459,52 @@ npAPI int npUpdateSelection(
     float3 *selection_pos, float3 *selection_normal)
 {
     auto num_vertices = model->num_vertices;
-    auto vertices = model->vertices;
     auto normals = model->normals;
     auto selection = model->selection;
 
-    float st = 0.0f;
+    double st = 0.0;
     int num_selected = 0;
-    float3 spos = float3::zero();
-    float3 snormal = float3::zero();
+    double3 spos = double3::zero();
+    double3 snormal = double3::zero();
     quatf srot = quatf::identity();
 
-    for (int vi = 0; vi < num_vertices; ++vi) {
-        float s = selection[vi];
-        if (s > 0.0f) {
-            spos += vertices[vi] * s;
-            snormal += normals[vi] * s;
-            ++num_selected;
-            st += s;
+    if (auto *index = GetSelectionStats(*model)) {
+        num_selected = index->num_selected;
+        st = index->weight;
+        spos = index->weighted_pos;
+
+        // normals are modified by many functions without notice. they are summed on each call.
+        if (index->active.size() * 8 < (size_t)num_vertices) {
+            for (int vi : index->active) {
+                float s = selection[vi];
+                if (s > 0.0f) {
+                    float3 n = normals[vi] * s;
+                    snormal += double3{ n.x, n.y, n.z };
+                }
+            }
         }
+        else {
+            double tmp;
+            SumSelected(normals, selection, num_vertices, snormal, tmp);
+        }
+    }
+    else {
+        num_selected = SumSelected(model->vertices, selection, num_vertices, spos, st);
+        SumSelected(normals, selection, num_vertices, snormal, st);
     }
 
+    float3 rpos = float3::zero();
+    float3 rnormal = float3::zero();
     if (num_selected > 0) {
         auto trans = model->transform;
         spos /= st;
-        spos = mul_p(trans, spos);
-        snormal = normalize(mul_v(trans, snormal));
-        srot = to_quat(look33(snormal, {0,1,0}));
+        rpos = mul_p(trans, float3{ (float)spos.x, (float)spos.y, (float)spos.z });
+        rnormal = normalize(mul_v(trans, float3{ (float)snormal.x, (float)snormal.y, (float)snormal.z }));
+        srot = to_quat(look33(rnormal, {0,1,0}));
     }
 
-    *selection_pos = spos;
-    *selection_normal = snormal;
+    *selection_pos = rpos;
+    *selection_normal = rnormal;
     return num_selected;
 }
 
@@ -517,33 +1512,23 @@ npAPI int npUpdateSelection(
 npAPI void npAssign(
     npMeshData *model, float3 value)
 {
-    auto num_vertices = model->num_vertices;
     auto normals = model->normals;
-    auto selection = model->selection;
 
     value = mul_v(invert(model->transform), value);
-    for (int vi = 0; vi < num_vertices; ++vi) {
-        float s = selection[vi];
-        if (s == 0.0f) continue;
-
+    EachSelected(*model, [&](int vi, float s) {
         normals[vi] = normalize(lerp(normals[vi], value, s));
-    }
+    });
 }
 
 npAPI void npMove(
     npMeshData *model, float3 value)
 {
-    auto num_vertices = model->num_vertices;
     auto normals = model->normals;
-    auto selection = model->selection;
 
     value = mul_v(invert(model->transform), value);
-    for (int vi = 0; vi < num_vertices; ++vi) {
-        float s = selection[vi];
-        if (s == 0.0f) continue;
-
+    EachSelected(*model, [&](int vi, float s) {
         normals[vi] = normalize(normals[vi] + value * s);
-    }
+    });
 }
 
 npAPI void npRotate(
@@ -556,9 +1541,7 @@ npAPI void npRotate(
         return;
     }
 
-    auto num_vertices = model->num_vertices;
     auto normals = model->normals;
-    auto selection = model->selection;
 
     auto ptrans = to_mat4x4(invert(pivot_rot));
     auto iptrans = invert(ptrans);
@@ -568,14 +1551,11 @@ npAPI void npRotate(
 
     auto to_lspace = trans * iptrans * rot * ptrans * itrans;
 
-    for (int vi = 0; vi < num_vertices; ++vi) {
-        float s = selection[vi];
-        if (s == 0.0f) continue;
-
+    EachSelected(*model, [&](int vi, float s) {
         float3 n = normals[vi];
         float3 v = normalize(mul_v(to_lspace, n));
         normals[vi] = normalize(lerp(n, v, s));
-    }
+    });
 }
 
 npAPI void npRotatePivot(
@@ -594,10 +1574,8 @@ npAPI void npRotatePivot(
         return;
     }
 
-    auto num_vertices = model->num_vertices;
     auto vertices = model->vertices;
     auto normals = model->normals;
-    auto selection = model->selection;
 
     auto ptrans = to_mat4x4(invert(pivot_rot)) * translate(pivot_pos);
     auto iptrans = invert(ptrans);
@@ -608,17 +1586,14 @@ npAPI void npRotatePivot(
     auto to_lspace = ptrans * itrans;
     auto rot = to_mat3x3(value);
 
-    for (int vi = 0; vi < num_vertices; ++vi) {
-        float s = selection[vi];
-        if (s == 0.0f) continue;
-
+    EachSelected(*model, [&](int vi, float s) {
         float3 vpos = mul_p(to_pspace, vertices[vi]);
         float d = length(vpos);
         float3 v = vpos - (rot * vpos);
-        if(near_equal(length(v), 0.0f)) { continue; }
+        if(near_equal(length(v), 0.0f)) { return; }
         v = normalize(mul_v(to_lspace, v));
         normals[vi] = normalize(normals[vi] + v * (d / furthest * angle * s));
-    }
+    });
 }
 
 npAPI void npScale(
@@ -630,10 +1605,8 @@ npAPI void npScale(
         return;
     }
 
-    auto num_vertices = model->num_vertices;
     auto vertices = model->vertices;
     auto normals = model->normals;
-    auto selection = model->selection;
 
     auto ptrans = to_mat4x4(invert(pivot_rot)) * translate(pivot_pos);
     auto iptrans = invert(ptrans);
@@ -643,15 +1616,12 @@ npAPI void npScale(
     auto to_pspace = trans * iptrans;
     auto to_lspace = ptrans * itrans;
 
-    for (int vi = 0; vi < num_vertices; ++vi) {
-        float s = selection[vi];
-        if (s == 0.0f) continue;
-
+    EachSelected(*model, [&](int vi, float s) {
         float3 vpos = mul_p(to_pspace, vertices[vi]);
         float d = length(vpos);
         float3 v = mul_v(to_lspace, (vpos / d) * value);
         normals[vi] = normalize(normals[vi] + v * (d / furthest * s));
-    }
+    });
 }
 
 npAPI void npSmooth(
@@ -662,29 +1632,66 @@ npAPI void npSmooth(
     auto normals = model->normals;
     auto selection = model->selection;
 
-    RawVector<float3> tvertices;
-    tvertices.resize(num_vertices);
-    parallel_for(0, num_vertices, [&](int vi) {
-        tvertices[vi] = mul_p(model->transform, vertices[vi]);
-    });
+    // neighbors are searched in the grid of world space vertex positions
+    PointGrid tmp;
+    auto *grid = GetVertexGrid(*model);
+    if (!grid) {
+        RawVector<float3> tvertices;
+        tvertices.resize_discard(num_vertices);
+        parallel_for_blocked(0, num_vertices, npVertexBlockSize, [&](int vi, int vend) {
+            for (; vi < vend; ++vi) {
+                tvertices[vi] = mul_p(model->transform, vertices[vi]);
+            }
+        });
+        tmp.build(tvertices);
+        grid = &tmp;
+    }
+    auto& tvertices = grid->points;
+
+    // normals are updated in place in ascending order of vertices: averages include the smoothed normals of the preceding
+    // vertices, same as the serial loop over all vertices. neighbors of a chunk of vertices are gathered in parallel first.
+    const int num_blocks = 16;
+    std::vector<RawVector<int>> neighbors(num_blocks), offsets(num_blocks);
+    for (int cbegin = 0; cbegin < num_vertices; cbegin += npVertexBlockSize * num_blocks) {
+        int cend = std::min(cbegin + npVertexBlockSize * num_blocks, num_vertices);
+        int nblocks = ceildiv(cend - cbegin, npVertexBlockSize);
+        parallel_for(0, nblocks, [&](int bi) {
+            auto& dst = neighbors[bi];
+            auto& offs = offsets[bi];
+            dst.clear();
+            offs.clear();
+            RawVector<int> tmp;
+            int vend = std::min(cbegin + (bi + 1) * npVertexBlockSize, cend);
+            for (int vi = cbegin + bi * npVertexBlockSize; vi < vend; ++vi) {
+                offs.push_back((int)dst.size());
+                float s = mask ? selection[vi] : 1.0f;
+                if (s == 0.0f) { continue; }
+                grid->gather(tvertices[vi], radius, tmp);
+                for (int i : tmp) { dst.push_back(i); }
+            }
+            offs.push_back((int)dst.size());
+        });
 
-    float rsq = radius * radius;
-    parallel_for(0, num_vertices, [&](int vi) {
-        float s = mask ? selection[vi] : 1.0f;
-        if (s == 0.0f) { return; }
-
-        float3 p = tvertices[vi];
-        float3 average = float3::zero();
-        for (int i = 0; i < num_vertices; ++i) {
-            float s2 = selection ? selection[i] : 1.0f;
-            float dsq = length_sq(tvertices[i] - p);
-            if (dsq <= rsq) {
-                average += normals[i] * s2;
+        for (int bi = 0; bi < nblocks; ++bi) {
+            auto& src = neighbors[bi];
+            auto& offs = offsets[bi];
+            int vbegin = cbegin + bi * npVertexBlockSize;
+            int vend = std::min(vbegin + npVertexBlockSize, cend);
+            for (int vi = vbegin; vi < vend; ++vi) {
+                float s = mask ? selection[vi] : 1.0f;
+                if (s == 0.0f) { continue; }
+
+                float3 average = float3::zero();
+                for (int i = offs[vi - vbegin]; i < offs[vi - vbegin + 1]; ++i) {
+                    int ni = src[i];
+                    float s2 = selection ? selection[ni] : 1.0f;
+                    average += normals[ni] * s2;
+                }
+                average = normalize(average);
+                normals[vi] = normalize(normals[vi] + average * (strength * s));
             }
         }
-        average = normalize(average);
-        normals[vi] = normalize(normals[vi] + average * (strength * s));
-    });
+    }
 }
 
 npAPI int npWeld(
@@ -695,40 +1702,104 @@ npAPI int npWeld(
     auto normals = model->normals;
     auto selection = model->selection;
 
+    // coincident vertices (closer than npEpsilon) of each vertex, in ascending order
+    PointHashGrid grid;
+    grid.build(IArray<float3>(vertices, num_vertices), npEpsilon);
+
+    RawVector<int> offsets, neighbors;
+    grid.gatherAll(offsets, neighbors);
+
+    // groups of vertices connected by coincidence. welding in a group never affects other groups,
+    // so groups are processed in parallel with the same result as processing all vertices in order.
+    RawVector<int> group_of;
+    group_of.resize_discard(num_vertices);
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        group_of[vi] = vi;
+    }
+    auto find = [&](int v) {
+        while (group_of[v] != v) {
+            group_of[v] = group_of[group_of[v]];
+            v = group_of[v];
+        }
+        return v;
+    };
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        for (int i = offsets[vi]; i < offsets[vi + 1]; ++i) {
+            int a = find(vi), b = find(neighbors[i]);
+            if (a != b) { group_of[std::max(a, b)] = std::min(a, b); }
+        }
+    }
+
+    // vertices of each group in ascending order (groups of a single vertex are omitted)
+    RawVector<int> group_offsets, group_vertices;
+    {
+        RawVector<int> group_count;
+        group_count.resize_zeroclear(num_vertices);
+        for (int vi = 0; vi < num_vertices; ++vi) {
+            group_of[vi] = find(vi);
+            ++group_count[group_of[vi]];
+        }
+        RawVector<int> group_index;
+        group_index.resize_discard(num_vertices);
+        int num_groups = 0, total = 0;
+        group_offsets.push_back(0);
+        for (int vi = 0; vi < num_vertices; ++vi) {
+            if (group_of[vi] == vi && group_count[vi] > 1) {
+                group_index[vi] = num_groups++;
+                total += group_count[vi];
+                group_offsets.push_back(total);
+            }
+        }
+        RawVector<int> pos;
+        pos.assign(group_offsets.begin(), group_offsets.end() - 1);
+        group_vertices.resize_discard(total);
+        for (int vi = 0; vi < num_vertices; ++vi) {
+            int g = group_of[vi];
+            if (group_count[g] > 1) {
+                group_vertices[pos[group_index[g]]++] = vi;
+            }
+        }
+    }
+
     RawVector<bool> checked;
     checked.resize(num_vertices);
     checked.zeroclear();
 
-    int ret = 0;
-    RawVector<int> shared;
-    for (int vi = 0; vi < num_vertices; ++vi) {
-        if (checked[vi]) { continue; }
-        float s = mask ? selection[vi] : 1.0f;
-        if (s == 0.0f) { continue; }
+    std::atomic_int ret{ 0 };
+    int num_groups = (int)group_offsets.size() - 1;
+    parallel_for(0, num_groups, [&](int gi) {
+        int welded = 0;
+        RawVector<int> shared;
+        for (int gvi = group_offsets[gi]; gvi < group_offsets[gi + 1]; ++gvi) {
+            int vi = group_vertices[gvi];
+            if (checked[vi]) { continue; }
+            float s = mask ? selection[vi] : 1.0f;
+            if (s == 0.0f) { continue; }
 
-        float3 p = vertices[vi];
-        float3 n = normals[vi];
-        for (int i = 0; i < num_vertices; ++i) {
-            if (vi != i && !checked[i] &&
-                length(vertices[i] - p) < npEpsilon &&
-                angle_between(n, normals[i]) * Rad2Deg <= weld_angle)
-            {
-                if (smoothing) n += normals[i];
-                shared.push_back(i);
-                checked[i] = true;
+            float3 n = normals[vi];
+            for (int ni = offsets[vi]; ni < offsets[vi + 1]; ++ni) {
+                int i = neighbors[ni];
+                if (vi != i && !checked[i] &&
+                    angle_between(n, normals[i]) * Rad2Deg <= weld_angle)
+                {
+                    if (smoothing) n += normals[i];
+                    shared.push_back(i);
+                    checked[i] = true;
+                }
             }
-        }
 
-        if (!shared.empty()) {
-            n = normalize(n);
-            normals[vi] = n;
-            for (int si : shared) {
-                normals[si] = n;
+            if (!shared.empty()) {
+                n = normalize(n);
+                normals[vi] = n;
+                for (int si : shared) {
+                    normals[si] = n;
+                }
+                shared.clear();
+                ++welded;
             }
-            shared.clear();
-            ++ret;
         }
-    }
+        ret += welded;
+    });
 
     return ret;
 }
@@ -748,58 +1819,75 @@ npAPI int npWeld2(
 
     RawVector<float4x4> titrans;
     RawVector<float3> wvertices, wnormals;
-    std::vector<RawVector<float3>> twvertices, twnormals;
+    RawVector<float3> twvertices, twnormals; // world space vertices of all targets. target ti's start at toffsets[ti]
+    RawVector<int> toffsets;
 
     // generate world space vertices
-    wvertices.resize(num_vertices);
-    wnormals.resize(num_vertices);
-    for (int vi = 0; vi < num_vertices; ++vi) {
-        wvertices[vi] = mul_p(trans, vertices[vi]);
-        wnormals[vi] = mul_v(trans, normals[vi]);
-    }
+    wvertices.resize_discard(num_vertices);
+    wnormals.resize_discard(num_vertices);
+    parallel_for_blocked(0, num_vertices, npVertexBlockSize, [&](int vi, int vend) {
+        for (; vi < vend; ++vi) {
+            wvertices[vi] = mul_p(trans, vertices[vi]);
+            wnormals[vi] = mul_v(trans, normals[vi]);
+        }
+    });
 
-    titrans.resize(num_targets);
-    twvertices.resize(num_targets);
-    twnormals.resize(num_targets);
+    titrans.resize_discard(num_targets);
+    toffsets.resize_discard(num_targets + 1);
+    toffsets[0] = 0;
     for (int ti = 0; ti < num_targets; ++ti) {
+        titrans[ti] = invert(targets[ti].transform);
+        toffsets[ti + 1] = toffsets[ti] + targets[ti].num_vertices;
+    }
+    twvertices.resize_discard(toffsets[num_targets]);
+    twnormals.resize_discard(toffsets[num_targets]);
+    parallel_for(0, num_targets, [&](int ti) {
         auto tt = targets[ti].transform;
-        titrans[ti] = invert(tt);
-
         auto tva = targets[ti].vertices;
         auto tna = targets[ti].normals;
-        auto& twva = twvertices[ti];
-        auto& twna = twnormals[ti];
-        int num_tv = targets[ti].num_vertices;
-        twva.resize(num_tv);
-        twna.resize(num_tv);
-        for (int tvi = 0; tvi < num_tv; ++tvi) {
-            twva[tvi] = mul_p(tt, tva[tvi]);
-            twna[tvi] = mul_v(tt, tna[tvi]);
-        }
-    }
-
-    std::vector<RawVector<std::pair<int, int>>> weld_maps;
-    weld_maps.resize(num_targets);
-
-    // generate weld maps
-    for (int ti = 0; ti < num_targets; ++ti) {
-        auto& weld_map = weld_maps[ti];
+        auto twva = &twvertices[toffsets[ti]];
+        auto twna = &twnormals[toffsets[ti]];
+        parallel_for_blocked(0, targets[ti].num_vertices, npVertexBlockSize, [&](int tvi, int tvend) {
+            for (; tvi < tvend; ++tvi) {
+                twva[tvi] = mul_p(tt, tva[tvi]);
+                twna[tvi] = mul_v(tt, tna[tvi]);
+            }
+        });
+    });
 
-        for (int vi = 0; vi < num_vertices; ++vi) {
+    // one grid for vertices of all targets
+    PointHashGrid grid;
+    grid.build(twvertices, npEpsilon);
+
+    // generate weld maps. (vertex, target vertex) pairs of each target, in ascending order of vertex then target vertex.
+    int num_blocks = ceildiv(num_vertices, npVertexBlockSize);
+    std::vector<RawVector<std::pair<int, int>>> block_maps; // (vertex, index in twvertices)
+    block_maps.resize(num_blocks);
+    parallel_for(0, num_blocks, [&](int bi) {
+        auto& dst = block_maps[bi];
+        RawVector<int> near;
+        int vend = std::min(num_vertices, (bi + 1) * npVertexBlockSize);
+        for (int vi = bi * npVertexBlockSize; vi < vend; ++vi) {
             float s = mask ? selection[vi] : 1.0f;
             if (s == 0.0f) { continue; }
 
-            auto p = wvertices[vi];
             auto n = wnormals[vi];
-            auto& twva = twvertices[ti];
-            auto& twna = twnormals[ti];
-            int num_tv = targets[ti].num_vertices;
-            for (int tvi = 0; tvi < num_tv; ++tvi) {
-                if (length(twva[tvi] - p) < npEpsilon && angle_between(n, twna[tvi]) * Rad2Deg <= weld_angle) {
-                    weld_map.push_back({ vi, tvi });
+            grid.gather(wvertices[vi], near);
+            for (int i : near) {
+                if (angle_between(n, twnormals[i]) * Rad2Deg <= weld_angle) {
+                    dst.push_back({ vi, i });
                 }
             }
         }
+    });
+
+    std::vector<RawVector<std::pair<int, int>>> weld_maps;
+    weld_maps.resize(num_targets);
+    for (auto& map : block_maps) {
+        for (auto& rel : map) {
+            int ti = int(std::upper_bound(toffsets.begin(), toffsets.end(), rel.second) - toffsets.begin()) - 1;
+            weld_maps[ti].push_back({ rel.first, rel.second - toffsets[ti] });
+        }
     }
 
     int ret = 0;
@@ -822,7 +1910,7 @@ npAPI int npWeld2(
         // copy from targets
         for (int ti = 0; ti < num_targets; ++ti) {
             auto& weld_map = weld_maps[ti];
-            auto& twna = twnormals[ti];
+            auto twna = &twnormals[toffsets[ti]];
             for (auto& rel : weld_map) {
                 normals[rel.first] = mul_v(itrans, twna[rel.second]);
             }
@@ -834,7 +1922,7 @@ npAPI int npWeld2(
 
         for (int ti = 0; ti < num_targets; ++ti) {
             auto& weld_map = weld_maps[ti];
-            auto& twna = twnormals[ti];
+            auto twna = &twnormals[toffsets[ti]];
             for (auto& rel : weld_map) {
                 tmp_wnormals[rel.first] += twna[rel.second];
             }
@@ -857,53 +1945,93 @@ npAPI int npWeld2(
 }
 
 
-npAPI int npBrushFlow(
-    npMeshData *model,
-    const float3 pos, const float3 previousPos, float radius, float strength, int num_bsamples, float bsamples[], float3 value, int mask)
+// vertices of a dab are searched by a selector: [](float3 pos, float radius, body, bool parallel) -> int
+// that behaves as SelectInside(). npModelSelector searches the whole model, npStrokeSelector the vertices gathered for a stroke.
+struct npModelSelector
+{
+    const npMeshData& model;
+
+    template<class Body>
+    int operator()(float3 pos, float radius, const Body& body, bool parallel = false) const
+    {
+        return SelectInside(model, pos, radius, body, parallel);
+    }
+};
+
+// vertices within radius of the dabs of a stroke (world space), gathered once for all dabs.
+// candidates are ascending in vertex index, so each dab receives vertices in ascending order as SelectInside() does.
+struct npStrokeSelector
+{
+    RawVector<int> vertices;    // candidate -> vertex index
+    PointGrid grid;             // world positions of candidates
+    mutable RawVector<int> inside;
+
+    template<class Body>
+    int operator()(float3 pos, float radius, const Body& body, bool parallel = false) const
+    {
+        grid.gather(pos, radius, inside);
+        int num_inside = (int)inside.size();
+        auto do_select = [&](int i) {
+            int ci = inside[i];
+            float3 p = grid.points[ci];
+            body(vertices[ci], std::sqrt(length_sq(p - pos)), p);
+        };
+        if (parallel) {
+            parallel_for_blocked(0, num_inside, npVertexBlockSize, [&](int i, int iend) {
+                for (; i < iend; ++i) { do_select(i); }
+            });
+        }
+        else {
+            for (int i = 0; i < num_inside; ++i) { do_select(i); }
+        }
+        return num_inside;
+    }
+};
+
+template<class Selector>
+static int BrushFlow(npMeshData *model, const Selector& select,
+    const float3 pos, const float3 previousPos, float radius, float strength, int num_bsamples, float bsamples[], int mask)
 {
     auto normals = model->normals;
     auto selection = model->selection;
     auto sign = strength < 0.0f ? -1.0f : 1.0f;
     auto direction = normalize(pos - previousPos);
     //auto axis = cross(value, direction);
-    return SelectInside(*model, pos, radius, [&](int vi, float d, float3 p) {
+    return select(pos, radius, [&](int vi, float d, float3 p) {
         float s = GetBrushSample(d, radius, bsamples, num_bsamples) * abs(strength);
         if (mask) s *= selection[vi];
 
         normals[vi] = normalize(lerp(normals[vi], direction, s * sign));
     }, true);
-    return 0;
 }
 
-npAPI int npBrushReplace(
-    npMeshData *model,
+template<class Selector>
+static int BrushReplace(npMeshData *model, const Selector& select,
     const float3 pos, float radius, float strength, int num_bsamples, float bsamples[], float3 value, int mask)
 {
     auto normals = model->normals;
     auto selection = model->selection;
     auto sign = strength < 0.0f ? -1.0f : 1.0f;
 
-    return SelectInside(*model, pos, radius, [&](int vi, float d, float3 p) {
+    return select(pos, radius, [&](int vi, float d, float3 p) {
         float s = GetBrushSample(d, radius, bsamples, num_bsamples) * abs(strength);
         if (mask) s *= selection[vi];
 
         normals[vi] = normalize(normals[vi] + value * (s * sign));
     }, true);
-    return 0;
 }
 
-npAPI int npBrushPaint(
-    npMeshData *model,
+// itrans: invert(model->transform)
+template<class Selector>
+static int BrushPaint(npMeshData *model, const Selector& select, const float4x4& itrans,
     const float3 pos, float radius, float strength, int num_bsamples, float bsamples[], float3 n, int blend_mode, int mask)
 {
     auto normals = model->normals;
     auto selection = model->selection;
     auto sign = strength < 0.0f ? -1.0f : 1.0f;
 
-    float3 ln = n;
     n = normalize(mul_v(model->transform, n));
-    auto itrans = invert(model->transform);
-    return SelectInside(*model, pos, radius, [&](int vi, float d, float3 p) {
+    return select(pos, radius, [&](int vi, float d, float3 p) {
         int bsi = GetBrushSampleIndex(d, radius, num_bsamples);
         float s = saturate(bsamples[bsi] * abs(strength) * 2.0f);
         if (mask) s *= selection[vi];
@@ -943,15 +2071,15 @@ npAPI int npBrushPaint(
     }, true);
 }
 
-npAPI int npBrushLerp(
-    npMeshData *model,
+template<class Selector>
+static int BrushLerp(npMeshData *model, const Selector& select,
     const float3 pos, float radius, float strength, int num_bsamples, float bsamples[], const float3 n0[], const float3 n1[], int mask)
 {
     auto normals = model->normals;
     auto selection = model->selection;
     auto sign = strength < 0.0f ? -1.0f : 1.0f;
 
-    return SelectInside(*model, pos, radius, [&](int vi, float d, float3 p) {
+    return select(pos, radius, [&](int vi, float d, float3 p) {
         float s = GetBrushSample(d, radius, bsamples, num_bsamples) * abs(strength);
         if (mask) s *= selection[vi];
 
@@ -959,15 +2087,15 @@ npAPI int npBrushLerp(
     }, true);
 }
 
-npAPI int npBrushSmooth(
-    npMeshData *model,
+template<class Selector>
+static int BrushSmooth(npMeshData *model, const Selector& select,
     const float3 pos, float radius, float strength, int num_bsamples, float bsamples[], int mask)
 {
     auto normals = model->normals;
     auto selection = model->selection;
 
     RawVector<std::pair<int, float>> inside;
-    SelectInside(*model, pos, radius, [&](int vi, float d, float3 p) {
+    select(pos, radius, [&](int vi, float d, float3 p) {
         inside.push_back({ vi, d });
     });
 
@@ -987,53 +2115,419 @@ npAPI int npBrushSmooth(
     return (int)inside.size();
 }
 
-template<class RayDirs>
-inline int BrushProjectionImpl(
+npAPI int npBrushFlow(
     npMeshData *model,
-    const float3 pos, float radius, float strength, int num_bsamples, float bsamples[], int mask,
-    npMeshData *normal_source, const RayDirs& ray_dirs)
+    const float3 pos, const float3 previousPos, float radius, float strength, int num_bsamples, float bsamples[], float3 value, int mask)
+{
+    return BrushFlow(model, npModelSelector{ *model }, pos, previousPos, radius, strength, num_bsamples, bsamples, mask);
+}
+
+npAPI int npBrushReplace(
+    npMeshData *model,
+    const float3 pos, float radius, float strength, int num_bsamples, float bsamples[], float3 value, int mask)
+{
+    return BrushReplace(model, npModelSelector{ *model }, pos, radius, strength, num_bsamples, bsamples, value, mask);
+}
+
+npAPI int npBrushPaint(
+    npMeshData *model,
+    const float3 pos, float radius, float strength, int num_bsamples, float bsamples[], float3 n, int blend_mode, int mask)
+{
+    return BrushPaint(model, npModelSelector{ *model }, invert(model->transform),
+        pos, radius, strength, num_bsamples, bsamples, n, blend_mode, mask);
+}
+
+npAPI int npBrushLerp(
+    npMeshData *model,
+    const float3 pos, float radius, float strength, int num_bsamples, float bsamples[], const float3 n0[], const float3 n1[], int mask)
+{
+    return BrushLerp(model, npModelSelector{ *model }, pos, radius, strength, num_bsamples, bsamples, n0, n1, mask);
+}
+
+npAPI int npBrushSmooth(
+    npMeshData *model,
+    const float3 pos, float radius, float strength, int num_bsamples, float bsamples[], int mask)
+{
+    return BrushSmooth(model, npModelSelector{ *model }, pos, radius, strength, num_bsamples, bsamples, mask);
+}
+
+enum class npBrushMode
+{
+    Paint,
+    Replace,
+    Smooth,
+    Projection,
+    Reset,
+    Flow,
+};
+
+struct npBrushDab
+{
+    float3 pos;
+    float pressure;
+    float3 value;
+};
+
+// places dabs every step along the polyline. points[0] is where the previous dab was placed.
+static void PlaceDabs(const float3 points[], const float pressures[], const float3 values[], int num_points, float step,
+    RawVector<npBrushDab>& dst)
+{
+    dst.clear();
+    float travelled = 0.0f; // since the last dab
+    for (int i = 0; i + 1 < num_points; ++i) {
+        float3 a = points[i], b = points[i + 1];
+        float len = length(b - a);
+        if (len <= 0.0f) { continue; }
+
+        float pa = pressures ? pressures[i] : 1.0f;
+        float pb = pressures ? pressures[i + 1] : 1.0f;
+        float3 va = values ? values[i] : float3::zero();
+        float3 vb = values ? values[i + 1] : float3::zero();
+        float t = step - travelled;
+        for (; t <= len; t += step) {
+            float u = t / len;
+            float3 v = va;
+            if (va != vb) {
+                // opposite values lerp through zero. the nearer end is taken there
+                v = lerp(va, vb, u);
+                float lv = length(v);
+                v = lv > 1e-6f ? v / lv : (u < 0.5f ? va : vb);
+            }
+            dst.push_back({ a + (b - a) * u, pa + (pb - pa) * u, v });
+        }
+        travelled = len - (t - step);
+    }
+}
+
+// vertices near the stroke. they are gathered once by the vertex grid, instead of once per dab.
+// dabs are joined into a polyline, and runs of dabs that are nearly straight become one segment whose capsule is widened
+// by the deviation. the result contains all vertices within radius of any dab.
+static void GatherStrokeVertices(const npMeshData& model, const npBrushDab *dabs, int num_dabs, float radius,
+    npStrokeSelector& dst)
+{
+    float tolerance = radius * 0.1f;
+    RawVector<float3> path;
+    path.push_back(dabs[0].pos);
+    for (int first = 0; first < num_dabs - 1;) {
+        // extend the segment from dabs[first] while dabs in between stay within tolerance of it. runs are limited to
+        // keep this linear in the number of dabs.
+        int last = first + 1;
+        for (int next = last + 1; next < num_dabs && next - first <= 64; ++next) {
+            float3 a = dabs[first].pos, ab = dabs[next].pos - a;
+            float lq = length_sq(ab);
+            bool straight = lq > 0.0f;
+            for (int di = first + 1; di < next && straight; ++di) {
+                float t = clamp01(dot(dabs[di].pos - a, ab) / lq);
+                straight = length_sq(a + ab * t - dabs[di].pos) <= tolerance * tolerance;
+            }
+            if (!straight) { break; }
+            last = next;
+        }
+        path.push_back(dabs[last].pos);
+        first = last;
+    }
+
+    // without the cached grid, a temporary one is built. it is still O(V) instead of testing every vertex with every dab
+    PointGrid tmp;
+    auto *grid = GetVertexGrid(model);
+    if (!grid) {
+        RawVector<float3> points;
+        points.resize_discard(model.num_vertices);
+        parallel_for_blocked(0, model.num_vertices, npVertexBlockSize, [&](int vi, int vend) {
+            for (; vi < vend; ++vi) {
+                points[vi] = mul_p(model.transform, model.vertices[vi]);
+            }
+        });
+        tmp.build(points);
+        grid = &tmp;
+    }
+
+    auto& vertices = dst.vertices;
+    grid->gatherSwept(path.data(), (int)path.size(), radius + tolerance, vertices);
+    int num_inside = (int)vertices.size();
+    RawVector<float3> points;
+    points.resize_discard(num_inside);
+    for (int i = 0; i < num_inside; ++i) {
+        points[i] = grid->points[vertices[i]];
+    }
+    // same cells as the vertex grid. the default size for the gathered points would make each dab cover most of them
+    dst.grid.build(points, grid->cell_size);
+}
+
+// applies dabs in order. prev is the position before the first dab. returns the number of painted vertices.
+template<class Selector>
+static int ApplyDabs(npMeshData *model, const Selector& select, npBrushMode mode, float3 prev, const RawVector<npBrushDab>& dabs,
+    float radius, float strength, int num_bsamples, float bsamples[], int blend_mode, const float3 base_normals[], int mask)
+{
+    auto itrans = invert(model->transform);
+    int ret = 0;
+    for (auto& dab : dabs) {
+        float s = strength * dab.pressure;
+        switch (mode) {
+        case npBrushMode::Paint:
+            ret += BrushPaint(model, select, itrans, dab.pos, radius, s, num_bsamples, bsamples, dab.value, blend_mode, mask);
+            break;
+        case npBrushMode::Replace:
+            ret += BrushReplace(model, select, dab.pos, radius, s, num_bsamples, bsamples, dab.value, mask);
+            break;
+        case npBrushMode::Smooth:
+            ret += BrushSmooth(model, select, dab.pos, radius, s, num_bsamples, bsamples, mask);
+            break;
+        case npBrushMode::Reset:
+            ret += BrushLerp(model, select, dab.pos, radius, s, num_bsamples, bsamples, base_normals, model->normals, mask);
+            break;
+        case npBrushMode::Flow:
+            ret += BrushFlow(model, select, dab.pos, prev, radius, s, num_bsamples, bsamples, mask);
+            break;
+        default:
+            break;
+        }
+        prev = dab.pos;
+    }
+    return ret;
+}
+
+// applies dabs along a polyline (world space) in one call. dabs are placed every spacing * radius from points[0], which is
+// the position of the last dab of the previous stroke call and is not painted again. strength of dabs is scaled by pressures.
+// brush_mode: same as npBrushMode. projection is not supported.
+// values: per point base normal of paint and value of replace. base_normals: target of reset. either may be null if unused.
+// last_dab receives the position of the last dab (points[0] if no dabs are placed). returns the number of painted vertices.
+npAPI int npBrushStroke(
+    npMeshData *model, int brush_mode,
+    const float3 points[], const float pressures[], const float3 values[], int num_points, float spacing,
+    float radius, float strength, int num_bsamples, float bsamples[], int blend_mode, const float3 base_normals[], int mask,
+    float3 *last_dab)
+{
+    auto mode = (npBrushMode)brush_mode;
+    if (last_dab) { *last_dab = num_points > 0 ? points[0] : float3::zero(); }
+    if (num_points < 2 || mode == npBrushMode::Projection) { return 0; }
+    if ((mode == npBrushMode::Paint || mode == npBrushMode::Replace) && !values) { return 0; }
+    if (mode == npBrushMode::Reset && !base_normals) { return 0; }
+
+    RawVector<npBrushDab> dabs;
+    PlaceDabs(points, pressures, values, num_points, std::max(spacing, 0.01f) * radius, dabs);
+    int num_dabs = (int)dabs.size();
+    if (num_dabs == 0) { return 0; }
+    if (last_dab) { *last_dab = dabs.back().pos; }
+
+    // geodesic distances depend on the position of each dab, so dabs are searched on the model.
+    // otherwise vertices near the stroke are gathered first and dabs search only them.
+    bool geodesic = model->cache && model->cache->brush_falloff == npBrushFalloff::Geodesic;
+    if (geodesic) {
+        return ApplyDabs(model, npModelSelector{ *model }, mode, points[0], dabs,
+            radius, strength, num_bsamples, bsamples, blend_mode, base_normals, mask);
+    }
+    npStrokeSelector select;
+    GatherStrokeVertices(*model, dabs.data(), num_dabs, radius, select);
+    return ApplyDabs(model, select, mode, points[0], dabs,
+        radius, strength, num_bsamples, bsamples, blend_mode, base_normals, mask);
+}
+
+// without cache, rays are tested by brute force, with TriangleClusters or with a BVH depending on the number of rays.
+// building clusters is ~10x faster than building a BVH, but clustered raycasts are ~40x slower than BVH traversal.
+#define npMinRaysForClusters 16
+#define npMinRaysForBVH 4096
+#define npMinPointsForBVH 256 // closest point queries have no clustered path
+#define npMaxBrushLocalTriangles 512 // beyond this, BVH traversal is faster than testing all gathered triangles
+
+// sphere that contains all ray origins, and the direction shared by all rays. in world space.
+struct npRaySweep
+{
+    float3 center;
+    float radius;
+    float3 dir;
+};
+
+// returns BVH of the projection source. nullptr if there is no cache and num_queries < min_queries.
+// the BVH is kept in the model's cache and rebuilt only when the source mesh is changed.
+// hash of up to 16 evenly spaced vertices and indices. O(1) regardless of the mesh size.
+static uint64_t SampleProjectionSource(const npMeshData *source)
+{
+    const int num_samples = 16;
+    auto num_indices = source->num_triangles * 3;
+    uint64_t h = 14695981039346656037ULL;
+    auto add = [&h](const void *data, size_t size) {
+        auto *bytes = (const uint8_t*)data;
+        for (size_t i = 0; i < size; ++i) { h = (h ^ bytes[i]) * 1099511628211ULL; }
+    };
+    for (int i = 0; i < num_samples && source->num_vertices > 0; ++i)
+        add(&source->vertices[(int)((int64_t)source->num_vertices * i / num_samples)], sizeof(float3));
+    for (int i = 0; i < num_samples && num_indices > 0; ++i)
+        add(&source->indices[(int)((int64_t)num_indices * i / num_samples)], sizeof(int));
+    return h;
+}
+
+// returns BVH of the projection source. nullptr if there is no cache and num_queries < min_queries.
+// the BVH is kept in the model's cache and rebuilt only when the source mesh is changed (see npProjectionSource).
+static const TriangleBVH* GetProjectionBVH(npMeshData *model, npMeshData *source, int num_queries, int min_queries, TriangleBVH& tmp)
+{
+    auto num_vertices = source->num_vertices;
+    auto num_indices = source->num_triangles * 3;
+
+    if (auto *cache = model->cache) {
+        auto& ps = cache->projection;
+        int version = source->cache ? source->cache->version : 0;
+        auto samples = SampleProjectionSource(source);
+        if (ps.bvh.empty() || ps.vertices != source->vertices || ps.indices != source->indices ||
+            ps.num_vertices != num_vertices || ps.num_triangles != source->num_triangles ||
+            ps.cache != source->cache || ps.version != version || ps.samples != samples)
+        {
+            ps.vertices = source->vertices;
+            ps.indices = source->indices;
+            ps.num_vertices = num_vertices;
+            ps.num_triangles = source->num_triangles;
+            ps.cache = source->cache;
+            ps.version = version;
+            ps.samples = samples;
+            ps.bvh.build(IArray<int>(source->indices, num_indices), IArray<float3>(source->vertices, num_vertices));
+        }
+        return &ps.bvh;
+    }
+    else if (num_queries >= min_queries) {
+        tmp.build(IArray<int>(source->indices, num_indices), IArray<float3>(source->vertices, num_vertices));
+        return &tmp;
+    }
+    return nullptr;
+}
+
+// casts rays from vertices of model along ray_dirs to the projection source, and blends normals at the hit positions.
+// targets and weights: vertex indices and blend weights.
+// rays are traced in the source's local space, so the source mesh doesn't need to be transformed.
+// sweep (optional): if given, source triangles around the swept sphere are gathered first and rays are tested only with them.
+template<class RayDirs>
+static void BlendProjectedNormals(
+    npMeshData *model, const RawVector<int>& targets, const RawVector<float>& weights, const RayDirs& ray_dirs, float sign,
+    npMeshData *source, const npRaySweep *sweep = nullptr)
 {
     auto vertices = model->vertices;
     auto normals = model->normals;
-    auto selection = model->selection;
+    auto pvertices = source->vertices;
+    auto pnormals = source->normals;
+    auto pindices = source->indices;
+    int num_rays = (int)targets.size();
+    if (num_rays == 0) { return; }
+
+    auto to_local = source->transform * invert(model->transform);
+    auto to_source = invert(to_local);
+
+    RawVector<float3> rpos, rdir;
+    RawVector<TriangleBVH::Hit> hits;
+    rpos.resize_discard(num_rays);
+    rdir.resize_discard(num_rays);
+    hits.resize_discard(num_rays);
+    parallel_for(0, num_rays, [&](int i) {
+        rpos[i] = mul_p(to_source, vertices[targets[i]]);
+        rdir[i] = normalize(mul_v(to_source, ray_dirs[targets[i]]));
+    });
+
+    TriangleBVH tmp;
+    auto *bvh = GetProjectionBVH(model, source, num_rays, npMinRaysForBVH, tmp);
 
-    auto pnum_triangles = normal_source->num_triangles;
-    auto pnormals = normal_source->normals;
-    auto pindices = normal_source->indices;
+    RawVector<int> local;
+    if (bvh && sweep) {
+        auto world_to_source = invert(source->transform);
+        float scale = 0.0f; // upper bound of the scale (frobenius norm of the 3x3 part)
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                scale += world_to_source[i][j] * world_to_source[i][j];
+            }
+        }
+        scale = std::sqrt(scale);
+        bvh->gatherSwept(
+            mul_p(world_to_source, sweep->center), sweep->radius * scale,
+            normalize(mul_v(world_to_source, sweep->dir)), local);
+    }
 
-    auto to_local = normal_source->transform * invert(model->transform);
-    RawVector<float3> pvertices;
-    pvertices.resize(normal_source->num_vertices);
-    for (int vi = 0; vi < normal_source->num_vertices; ++vi) {
-        pvertices[vi] = mul_p(to_local, normal_source->vertices[vi]);
+    if (!local.empty() && local.size() <= npMaxBrushLocalTriangles) {
+        // brush-local: rays are tested only with triangles around the brush
+        RawVector<float> soa[9];
+        int num_local = (int)local.size();
+        for (auto& a : soa) { a.resize_discard(num_local); }
+        for (int i = 0; i < num_local; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                auto& p = pvertices[pindices[local[i] * 3 + j]];
+                soa[j * 3 + 0][i] = p.x;
+                soa[j * 3 + 1][i] = p.y;
+                soa[j * 3 + 2][i] = p.z;
+            }
+        }
+        parallel_for(0, num_rays, [&](int i) {
+            auto& hit = hits[i];
+            if (RayTrianglesIntersectionSoA(rpos[i], rdir[i],
+                soa[0].data(), soa[1].data(), soa[2].data(),
+                soa[3].data(), soa[4].data(), soa[5].data(),
+                soa[6].data(), soa[7].data(), soa[8].data(),
+                num_local, hit.tindex, hit.distance))
+            {
+                hit.tindex = local[hit.tindex];
+            }
+            else {
+                hit.tindex = -1;
+            }
+        });
+    }
+    else if (bvh) {
+        bvh->raycast(rpos.data(), rdir.data(), num_rays, hits.data());
+    }
+    else if (num_rays >= npMinRaysForClusters) {
+        TriangleClusters clusters;
+        clusters.build(IArray<int>(pindices, source->num_triangles * 3), IArray<float3>(pvertices, source->num_vertices));
+        parallel_for(0, num_rays, [&](int i) {
+            auto& hit = hits[i];
+            if (!clusters.raycast(rpos[i], rdir[i], hit.tindex, hit.distance)) {
+                hit.tindex = -1;
+            }
+        });
+    }
+    else {
+        parallel_for(0, num_rays, [&](int i) {
+            auto& hit = hits[i];
+            if (!RayTrianglesIntersectionIndexed(rpos[i], rdir[i], pvertices, pindices, source->num_triangles, hit.tindex, hit.distance)) {
+                hit.tindex = -1;
+            }
+        });
     }
 
+    parallel_for(0, num_rays, [&](int i) {
+        auto& hit = hits[i];
+        if (hit.tindex == -1) { return; }
+
+        int ti = hit.tindex;
+        int vi = targets[i];
+        float3 result = triangle_interpolation(
+            rpos[i] + rdir[i] * hit.distance,
+            pvertices[pindices[ti * 3 + 0]],
+            pvertices[pindices[ti * 3 + 1]],
+            pvertices[pindices[ti * 3 + 2]],
+            pnormals[pindices[ti * 3 + 0]],
+            pnormals[pindices[ti * 3 + 1]],
+            pnormals[pindices[ti * 3 + 2]]);
+
+        result = normalize(mul_v(to_local, result));
+        normals[vi] = normalize(lerp(normals[vi], result * sign, weights[i]));
+    });
+}
+
+template<class RayDirs>
+inline int BrushProjectionImpl(
+    npMeshData *model,
+    const float3 pos, float radius, float strength, int num_bsamples, float bsamples[], int mask,
+    npMeshData *normal_source, const RayDirs& ray_dirs, const npRaySweep *sweep)
+{
+    auto selection = model->selection;
     auto sign = strength < 0.0f ? -1.0f : 1.0f;
 
-    return SelectInside(*model, pos, radius, [&](int vi, float d, float3 p) {
+    RawVector<int> targets;
+    RawVector<float> weights;
+    int ret = SelectInside(*model, pos, radius, [&](int vi, float d, float3 p) {
         float s = GetBrushSample(d, radius, bsamples, num_bsamples) * abs(strength);
         if (mask) s *= selection[vi];
+        targets.push_back(vi);
+        weights.push_back(s);
+    });
 
-        float3 rpos = vertices[vi];
-        float3 rdir = ray_dirs[vi];
-        int ti;
-        float distance;
-        int num_hit = RayTrianglesIntersectionIndexed(rpos, rdir, pvertices.data(), pindices, pnum_triangles, ti, distance);
-
-        if (num_hit > 0) {
-            float3 result = triangle_interpolation(
-                rpos + rdir * distance,
-                { pvertices[pindices[ti * 3 + 0]] },
-                { pvertices[pindices[ti * 3 + 1]] },
-                { pvertices[pindices[ti * 3 + 2]] },
-                pnormals[pindices[ti * 3 + 0]],
-                pnormals[pindices[ti * 3 + 1]],
-                pnormals[pindices[ti * 3 + 2]]);
-
-            result = normalize(mul_v(to_local, result));
-            normals[vi] = normalize(lerp(normals[vi], result * sign, s));
-        }
-    }, true);
+    BlendProjectedNormals(model, targets, weights, ray_dirs, sign, normal_source, sweep);
+    return ret;
 }
 
 npAPI int npBrushProjection(
@@ -1041,7 +2535,7 @@ npAPI int npBrushProjection(
     const float3 pos, float radius, float strength, int num_bsamples, float bsamples[], int mask,
     npMeshData *normal_source, float3 ray_dirs[])
 {
-    return BrushProjectionImpl(model, pos, radius, strength, num_bsamples, bsamples, mask, normal_source, ray_dirs);
+    return BrushProjectionImpl(model, pos, radius, strength, num_bsamples, bsamples, mask, normal_source, ray_dirs, nullptr);
 }
 
 npAPI int npBrushProjection2(
@@ -1054,12 +2548,15 @@ npAPI int npBrushProjection2(
         float3 ray_dir;
         const float3& operator[](int) const { return ray_dir; }
     } ray_dirs = { ray_dir };
-    return BrushProjectionImpl(model, pos, radius, strength, num_bsamples, bsamples, mask, normal_source, ray_dirs);
+    npRaySweep sweep = { pos, radius, mul_v(model->transform, ray_dir) };
+    return BrushProjectionImpl(model, pos, radius, strength, num_bsamples, bsamples, mask, normal_source, ray_dirs, &sweep);
 }
 
 
-npAPI int npBuildMirroringRelation(
-    npMeshData *model, float3 plane_normal, float epsilon, int relation[])
+// tolerance: 0: exact (npEpsilon), 1: exact, then epsilon, 2: exact, then epsilon, then nearest.
+// each step only searches for vertices left unmatched by the previous ones.
+npAPI int npBuildMirroringRelation2(
+    npMeshData *model, float3 plane_normal, float epsilon, int tolerance, int relation[])
 {
     auto num_vertices = model->num_vertices;
     auto vertices = model->vertices;
@@ -1071,31 +2568,97 @@ npAPI int npBuildMirroringRelation(
         distances[vi] = plane_distance(vertices[vi], plane_normal);
     });
 
-    std::atomic_int ret{ 0 };
-    parallel_for(0, num_vertices, [&](int vi) {
-        int rel = -1;
-        float d1 = distances[vi];
-        if (d1 < 0.0f) {
-            for (int i = 0; i < num_vertices; ++i) {
-                float d2 = distances[i];
-                if (d2 > 0.0f &&
-                    length(vertices[vi] - (vertices[i] - plane_normal * (d2 * 2.0f))) < npEpsilon)
-                {
-                    float3 n1 = normals[vi];
-                    float3 n2 = plane_mirror(normals[i], plane_normal);
-                    if (dot(n1, n2) >= 0.99f) {
-                        rel = i;
-                        ++ret;
+    // positive side vertices mirrored to the negative side. in ascending order of the original index.
+    RawVector<int> candidates;
+    RawVector<float3> mirrored;
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        float d = distances[vi];
+        if (d > 0.0f) {
+            candidates.push_back(vi);
+            mirrored.push_back(vertices[vi] - plane_normal * (d * 2.0f));
+        }
+    }
+
+    auto match = [&](int vi, int ci) {
+        float3 n1 = normals[vi];
+        float3 n2 = plane_mirror(normals[candidates[ci]], plane_normal);
+        return dot(n1, n2) >= 0.99f;
+    };
+
+    // the first candidate in index order within eps
+    auto find_coincident = [&](float eps) {
+        PointHashGrid grid;
+        grid.build(mirrored, eps);
+        parallel_for_blocked(0, num_vertices, npVertexBlockSize, [&](int vi, int vend) {
+            RawVector<int> neighbors;
+            for (; vi < vend; ++vi) {
+                if (relation[vi] != -1 || !(distances[vi] < 0.0f)) { continue; }
+                grid.gather(vertices[vi], neighbors);
+                for (int ci : neighbors) {
+                    if (match(vi, ci)) {
+                        relation[vi] = candidates[ci];
                         break;
                     }
                 }
             }
-        }
-        relation[vi] = rel;
+        });
+    };
+
+    parallel_for(0, num_vertices, [&](int vi) {
+        relation[vi] = -1;
     });
+    if (!candidates.empty()) {
+        find_coincident(npEpsilon);
+        if (tolerance >= 1 && epsilon > npEpsilon) {
+            find_coincident(epsilon);
+        }
+        if (tolerance >= 2) {
+            // widen the search radius until a candidate is found. everything closer is within the radius,
+            // so the best one in it is the nearest.
+            PointGrid grid;
+            grid.build(mirrored);
+            float initial_radius = std::max(grid.cell_size, epsilon);
+            parallel_for_blocked(0, num_vertices, npVertexBlockSize, [&](int vi, int vend) {
+                RawVector<int> neighbors;
+                for (; vi < vend; ++vi) {
+                    if (relation[vi] != -1 || !(distances[vi] < 0.0f)) { continue; }
+                    float3 pos = vertices[vi];
+                    for (float radius = initial_radius; ; radius *= 2.0f) {
+                        grid.gather(pos, radius, neighbors);
+                        int nearest = -1;
+                        float nearest_distance = FLT_MAX;
+                        for (int ci : neighbors) {
+                            float d = length_sq(mirrored[ci] - pos);
+                            if (d < nearest_distance && match(vi, ci)) {
+                                nearest = ci;
+                                nearest_distance = d;
+                            }
+                        }
+                        if (nearest != -1) {
+                            relation[vi] = candidates[nearest];
+                            break;
+                        }
+                        if (neighbors.size() == candidates.size() || !std::isfinite(radius)) { break; }
+                    }
+                }
+            });
+        }
+    }
+
+    int ret = 0;
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        if (relation[vi] != -1) { ++ret; }
+    }
     return ret;
 }
 
+// exact matches only. kept with its original signature for existing callers.
+npAPI int npBuildMirroringRelation(
+    npMeshData *model, float3 plane_normal, float epsilon, int relation[])
+{
+    return npBuildMirroringRelation2(model, plane_normal, epsilon, 0, relation);
+}
+
 npAPI void npApplyMirroring(int num_vertices, const int relation[], float3 plane_normal, float3 normals[])
 {
     parallel_for(0, num_vertices, [&](int vi) {
@@ -1106,66 +2669,32 @@ npAPI void npApplyMirroring(int num_vertices, const int relation[], float3 plane
 }
 
 
-template<class RayDirs>
-inline void ProjectNormalsImpl(
-    npMeshData *model, npMeshData *target, const RayDirs& ray_dirs, int mask)
+// vertices to be projected and their blend weights
+static void GatherProjectionTargets(npMeshData *model, int mask, RawVector<int>& targets, RawVector<float>& weights)
 {
     auto num_vertices = model->num_vertices;
-    auto vertices = model->vertices;
-    auto normals = model->normals;
     auto selection = model->selection;
 
-    auto pnum_triangles = target->num_triangles;
-    auto pvertices = target->vertices;
-    auto pnormals = target->normals;
-    auto pindices = target->indices;
-
-    auto to_local = target->transform * invert(model->transform);
-    RawVector<float> soa[9]; // flattened + SoA-nized vertices (faster on CPU)
-
-                             // flatten + SoA-nize
-    {
-        for (int i = 0; i < 9; ++i) {
-            soa[i].resize(pnum_triangles);
-        }
-        for (int ti = 0; ti < pnum_triangles; ++ti) {
-            for (int i = 0; i < 3; ++i) {
-                auto p = mul_p(to_local, pvertices[pindices[ti * 3 + i]]);
-                soa[i * 3 + 0][ti] = p.x;
-                soa[i * 3 + 1][ti] = p.y;
-                soa[i * 3 + 2][ti] = p.z;
-            }
-        }
+    targets.clear();
+    weights.clear();
+    targets.reserve(num_vertices);
+    weights.reserve(num_vertices);
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        float s = mask ? selection[vi] : 1.0f;
+        if (s == 0.0f) { continue; }
+        targets.push_back(vi);
+        weights.push_back(s);
     }
+}
 
-    parallel_for(0, num_vertices, [&](int vi) {
-        float s = mask ? selection[vi] : 1.0f;
-        if (s == 0.0f) { return; }
-
-        float3 rpos = vertices[vi];
-        float3 rdir = ray_dirs[vi];
-        int ti;
-        float distance;
-        int num_hit = RayTrianglesIntersectionSoA(rpos, rdir,
-            soa[0].data(), soa[1].data(), soa[2].data(),
-            soa[3].data(), soa[4].data(), soa[5].data(),
-            soa[6].data(), soa[7].data(), soa[8].data(),
-            pnum_triangles, ti, distance);
-
-        if (num_hit > 0) {
-            float3 result = triangle_interpolation(
-                rpos + rdir * distance,
-                { soa[0][ti], soa[1][ti], soa[2][ti] },
-                { soa[3][ti], soa[4][ti], soa[5][ti] },
-                { soa[6][ti], soa[7][ti], soa[8][ti] },
-                pnormals[pindices[ti * 3 + 0]],
-                pnormals[pindices[ti * 3 + 1]],
-                pnormals[pindices[ti * 3 + 2]]);
-
-            result = normalize(mul_v(to_local, result));
-            normals[vi] = normalize(lerp(normals[vi], result, s));
-        }
-    });
+template<class RayDirs>
+inline void ProjectNormalsImpl(
+    npMeshData *model, npMeshData *target, const RayDirs& ray_dirs, int mask)
+{
+    RawVector<int> targets;
+    RawVector<float> weights;
+    GatherProjectionTargets(model, mask, targets, weights);
+    BlendProjectedNormals(model, targets, weights, ray_dirs, 1.0f, target);
 }
 
 npAPI void npProjectNormals(
@@ -1186,6 +2715,83 @@ npAPI void npProjectNormals2(
 
 }
 
+// takes normals from the nearest points on the target surface instead of ray hits. never misses.
+npAPI void npProjectNormalsNearest(
+    npMeshData *model, npMeshData *target, int mask)
+{
+    RawVector<int> targets;
+    RawVector<float> weights;
+    GatherProjectionTargets(model, mask, targets, weights);
+    int num_points = (int)targets.size();
+    if (num_points == 0) { return; }
+
+    auto vertices = model->vertices;
+    auto normals = model->normals;
+    auto pvertices = target->vertices;
+    auto pnormals = target->normals;
+    auto pindices = target->indices;
+    auto to_local = target->transform * invert(model->transform);
+
+    RawVector<float3> qpos;
+    RawVector<TriangleBVH::Hit> hits;
+    qpos.resize_discard(num_points);
+    hits.resize_discard(num_points);
+
+    TriangleBVH tmp;
+    auto *bvh = GetProjectionBVH(model, target, num_points, npMinPointsForBVH, tmp);
+    if (IsSimilarityTransform(to_local)) {
+        // distances are scaled uniformly. search in the target's local space.
+        auto to_source = invert(to_local);
+        parallel_for(0, num_points, [&](int i) {
+            qpos[i] = mul_p(to_source, vertices[targets[i]]);
+        });
+        if (bvh) {
+            bvh->closestPoint(qpos.data(), num_points, FLT_MAX, hits.data());
+        }
+        else {
+            parallel_for(0, num_points, [&](int i) {
+                ClosestPointBruteForce(pvertices, pindices, target->num_triangles, qpos[i], hits[i]);
+            });
+        }
+    }
+    else {
+        // non-uniform scale or shear changes which point is the nearest. search in the model's space.
+        parallel_for(0, num_points, [&](int i) {
+            qpos[i] = vertices[targets[i]];
+        });
+        if (bvh) {
+            bvh->closestPoint(qpos.data(), num_points, to_local, FLT_MAX, hits.data());
+        }
+        else {
+            RawVector<float3> tvertices;
+            tvertices.resize_discard(target->num_vertices);
+            parallel_for_blocked(0, target->num_vertices, npVertexBlockSize, [&](int vi, int vend) {
+                for (; vi < vend; ++vi) {
+                    tvertices[vi] = mul_p(to_local, pvertices[vi]);
+                }
+            });
+            parallel_for(0, num_points, [&](int i) {
+                ClosestPointBruteForce(tvertices.data(), pindices, target->num_triangles, qpos[i], hits[i]);
+            });
+        }
+    }
+
+    parallel_for(0, num_points, [&](int i) {
+        auto& hit = hits[i];
+        if (hit.tindex == -1) { return; }
+
+        int ti = hit.tindex;
+        int vi = targets[i];
+        float3 result =
+            pnormals[pindices[ti * 3 + 0]] * (1.0f - hit.u - hit.v) +
+            pnormals[pindices[ti * 3 + 1]] * hit.u +
+            pnormals[pindices[ti * 3 + 2]] * hit.v;
+
+        result = normalize(mul_v(to_local, result));
+        normals[vi] = normalize(lerp(normals[vi], result, weights[i]));
+    });
+}
+
 template<int NumInfluence>
 static void SkinningImpl(
     int num_vertices, const RawVector<float4x4>& poses, const Weights<NumInfluence> weights[],
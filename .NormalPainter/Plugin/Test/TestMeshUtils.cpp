@@ -357,9 +357,67 @@ TestCase(TestMulPoints)
         Print("    *** validation failed ***\n");
     }
 #endif
+
+    // w grows with z, as perspective projections do
+    float4x4 proj = matrix;
+    proj[2][3] = 0.5f;
+    RawVector<float> x1, y1, z1, x2, y2, z2;
+    x1.resize(num_data); y1.resize(num_data); z1.resize(num_data);
+    x2.resize(num_data); y2.resize(num_data); z2.resize(num_data);
+    TestScope("ProjectPoints C++", [&]() {
+        ProjectPoints_Generic(proj, src.data(), x1.data(), y1.data(), z1.data(), num_data);
+    }, num_try);
+#ifdef muSIMD_ProjectPoints
+    TestScope("ProjectPoints ISPC", [&]() {
+        ProjectPoints_ISPC(proj, src.data(), x2.data(), y2.data(), z2.data(), num_data);
+    }, num_try);
+    if (!NearEqual(x1.data(), x2.data(), num_data) ||
+        !NearEqual(y1.data(), y2.data(), num_data) ||
+        !NearEqual(z1.data(), z2.data(), num_data))
+    {
+        Print("    *** validation failed ***\n");
+    }
+#endif
 }
 
 
+TestCase(TestWeightedSum)
+{
+    const int num_data = 65536;
+    const int num_try = 128;
+
+    RawVector<float3> src;
+    RawVector<float> weights;
+    src.resize(num_data);
+    weights.resize(num_data);
+    for (int i = 0; i < num_data; ++i) {
+        src[i] = { (float)(i % 256) * 0.1f, (float)(i % 97) * 0.05f, (float)(i % 31) * 0.025f };
+        weights[i] = i % 3 == 0 ? 0.0f : (float)(i % 7) / 6.0f;
+    }
+
+    Print(
+        "    num_data: %d\n"
+        "    num_try: %d\n",
+        num_data,
+        num_try);
+
+    float3 sum1, sum2;
+    float weight1, weight2;
+    int n1 = 0, n2 = 0;
+    TestScope("WeightedSum C++", [&]() {
+        n1 = WeightedSum_Generic(src.data(), weights.data(), num_data, sum1, weight1);
+    }, num_try);
+#ifdef muSIMD_WeightedSum
+    TestScope("WeightedSum ISPC", [&]() {
+        n2 = WeightedSum_ISPC(src.data(), weights.data(), num_data, sum2, weight2);
+    }, num_try);
+    if (n1 != n2 || !near_equal(sum1 / weight1, sum2 / weight2, 1e-4f)) {
+        Print("    *** validation failed ***\n");
+    }
+#endif
+    Print("    %d weighted, average: %f %f %f\n", n1, sum1.x / weight1, sum1.y / weight1, sum1.z / weight1);
+}
+
 TestCase(TestRayTrianglesIntersection)
 {
     RawVector<float3> vertices;
@@ -471,6 +529,625 @@ TestCase(TestRayTrianglesIntersection)
 #endif
 }
 
+TestCase(TestBVH)
+{
+    RawVector<int> counts, indices;
+    RawVector<float3> points;
+    RawVector<float2> uv;
+    GenerateWaveMesh(counts, indices, points, uv, 2.0f, 0.5f, 256, 0.0f, true);
+    int num_triangles = (int)indices.size() / 3;
+
+    const int num_rays = 2000;
+    RawVector<float3> ray_pos, ray_dir;
+    ray_pos.resize(num_rays); ray_dir.resize(num_rays);
+    for (int i = 0; i < num_rays; ++i) {
+        float a = (360.0f / num_rays) * i * Deg2Rad;
+        float r = float(i % 100) / 100.0f;
+        ray_pos[i] = { 0.0f, 3.0f, 0.0f };
+        ray_dir[i] = normalize(float3{ std::sin(a) * r, -1.0f, std::cos(a) * r });
+    }
+
+    RawVector<int> hit1, hit2, tindex1, tindex2;
+    RawVector<float> distance1, distance2;
+    hit1.resize_zeroclear(num_rays); hit2.resize_zeroclear(num_rays);
+    tindex1.resize_zeroclear(num_rays); tindex2.resize_zeroclear(num_rays);
+    distance1.resize_zeroclear(num_rays); distance2.resize_zeroclear(num_rays);
+
+    Print(
+        "    triangle count: %d\n"
+        "    ray count: %d\n",
+        num_triangles,
+        num_rays);
+
+    TestScope("brute force", [&]() {
+        for (int i = 0; i < num_rays; ++i) {
+            hit1[i] = RayTrianglesIntersectionIndexed(ray_pos[i], ray_dir[i], points.data(), indices.data(), num_triangles, tindex1[i], distance1[i]);
+        }
+    });
+
+    TriangleBVH bvh;
+    TestScope("BVH build", [&]() {
+        bvh.build(indices, points);
+    });
+    Print("        %d nodes\n", (int)bvh.nodes.size());
+
+    TestScope("BVH refit", [&]() {
+        bvh.refit(indices, points);
+    });
+
+    TestScope("BVH raycast", [&]() {
+        for (int i = 0; i < num_rays; ++i) {
+            hit2[i] = bvh.raycast(ray_pos[i], ray_dir[i], tindex2[i], distance2[i]);
+        }
+    });
+
+    for (int i = 0; i < num_rays; ++i) {
+        if ((hit1[i] > 0) != (hit2[i] > 0) ||
+            (hit1[i] && (tindex1[i] != tindex2[i] || !near_equal(distance1[i], distance2[i]))))
+        {
+            Print("    *** validation failed ***\n");
+            break;
+        }
+    }
+
+    RawVector<TriangleBVH::Hit> hits;
+    hits.resize(num_rays);
+    TestScope("BVH raycast batched", [&]() {
+        bvh.raycast(ray_pos.data(), ray_dir.data(), num_rays, hits.data());
+    });
+    for (int i = 0; i < num_rays; ++i) {
+        if ((hits[i].tindex != -1) != (hit1[i] > 0) ||
+            (hit1[i] && (tindex1[i] != hits[i].tindex || !near_equal(distance1[i], hits[i].distance))))
+        {
+            Print("    *** validation failed ***\n");
+            break;
+        }
+    }
+    // packets do the same arithmetic as single rays, so results must be identical
+    for (int i = 0; i < num_rays; ++i) {
+        if ((hits[i].tindex != -1) != hit2[i] || (hit2[i] && (tindex2[i] != hits[i].tindex || distance2[i] != hits[i].distance))) {
+            Print("    *** validation failed ***\n");
+            break;
+        }
+    }
+
+    TriangleClusters clusters;
+    TestScope("clusters build", [&]() {
+        clusters.build(indices, points);
+    });
+    Print("        %d clusters\n", clusters.numClusters());
+
+    TestScope("clusters raycast", [&]() {
+        for (int i = 0; i < num_rays; ++i) {
+            hit2[i] = clusters.raycast(ray_pos[i], ray_dir[i], tindex2[i], distance2[i]);
+        }
+    });
+    // on exact ties (rays through shared edges) the hit triangle may differ from brute force
+    for (int i = 0; i < num_rays; ++i) {
+        if ((hit1[i] > 0) != (hit2[i] > 0) ||
+            (hit1[i] && (tindex1[i] != tindex2[i] && distance1[i] != distance2[i])) ||
+            (hit1[i] && !near_equal(distance1[i], distance2[i])))
+        {
+            Print("    *** validation failed ***\n");
+            break;
+        }
+    }
+
+#if defined(muSIMD_RayTrianglesIntersectionClustered) || defined(muSIMD_RayTrianglesIntersectionSoA)
+    // Generic and ISPC kernels on the same data. axis aligned rays (zero direction components) are included.
+    // ISPC uses approximate reciprocals, so distances are compared with tolerance and either triangle of a tie is accepted.
+    {
+        auto& s = clusters.soa;
+        RawVector<float3> dirs = ray_dir;
+        dirs.push_back({ 0.0f, -1.0f, 0.0f });
+        dirs.push_back({ 1.0f, 0.0f, 0.0f });
+        dirs.push_back({ 0.0f, 0.0f, -1.0f });
+        auto Validate = [&](int n1, int ti1, float d1, int n2, int ti2, float d2) {
+            return (n1 > 0) == (n2 > 0) && (n1 == 0 || ((ti1 == ti2 || near_equal(d1, d2)) && near_equal(d1, d2)));
+        };
+        bool ok = true;
+        for (int i = 0; i < (int)dirs.size() && ok; ++i) {
+            float3 pos = i < num_rays ? ray_pos[i] : float3{ -1.5f, 0.1f, 1.5f };
+            int ti1 = -1, ti2 = -1;
+            float d1 = 0.0f, d2 = 0.0f;
+#ifdef muSIMD_RayTrianglesIntersectionClustered
+            int n1 = RayTrianglesIntersectionClustered_Generic(pos, dirs[i],
+                s[0].data(), s[1].data(), s[2].data(), s[3].data(), s[4].data(), s[5].data(), s[6].data(), s[7].data(), s[8].data(),
+                clusters.bb_min.data(), clusters.bb_max.data(), clusters.offsets.data(), clusters.numClusters(), ti1, d1);
+            int n2 = RayTrianglesIntersectionClustered_ISPC(pos, dirs[i],
+                s[0].data(), s[1].data(), s[2].data(), s[3].data(), s[4].data(), s[5].data(), s[6].data(), s[7].data(), s[8].data(),
+                clusters.bb_min.data(), clusters.bb_max.data(), clusters.offsets.data(), clusters.numClusters(), ti2, d2);
+            ok = ok && Validate(n1, ti1, d1, n2, ti2, d2);
+#endif
+#ifdef muSIMD_RayTrianglesIntersectionSoA
+            // a range that doesn't start at a multiple of the SIMD width
+            int begin = 3, count = clusters.offsets[clusters.numClusters()] - begin;
+            int n3 = RayTrianglesIntersectionSoA_Generic(pos, dirs[i],
+                s[0].data() + begin, s[1].data() + begin, s[2].data() + begin, s[3].data() + begin, s[4].data() + begin,
+                s[5].data() + begin, s[6].data() + begin, s[7].data() + begin, s[8].data() + begin, count, ti1, d1);
+            int n4 = RayTrianglesIntersectionSoA_ISPC(pos, dirs[i],
+                s[0].data() + begin, s[1].data() + begin, s[2].data() + begin, s[3].data() + begin, s[4].data() + begin,
+                s[5].data() + begin, s[6].data() + begin, s[7].data() + begin, s[8].data() + begin, count, ti2, d2);
+            ok = ok && n3 == n4 && Validate(n3, ti1, d1, n4, ti2, d2);
+#endif
+        }
+        if (!ok) {
+            Print("    *** validation failed ***\n");
+        }
+    }
+#endif
+
+    // instances of the BVH. compare with raycasting each instance in order
+    {
+        const int num_instances = 27;
+        RawVector<const TriangleBVH*> blas;
+        RawVector<float4x4> transforms;
+        for (int i = 0; i < num_instances; ++i) {
+            float3 t = { float(i % 3) * 3.0f - 3.0f, float(i / 9) * -0.7f, float(i / 3 % 3) * 3.0f - 3.0f };
+            blas.push_back(&bvh);
+            transforms.push_back(transform(t, rotateY(i * 0.3f), float3{ 1.0f + i * 0.05f, 1.0f, 1.0f }));
+        }
+
+        SceneBVH scene;
+        auto validate = [&]() {
+            for (int i = 0; i < num_rays; ++i) {
+                float3 pos = ray_pos[i] + float3{ float(i % 7) - 3.0f, 0.0f, float(i % 5) - 2.0f };
+                int instance = -1, tindex = -1;
+                float distance = std::numeric_limits<float>::max();
+                for (int ii = 0; ii < num_instances; ++ii) {
+                    float4x4 itrans = invert(transforms[ii]);
+                    float3 rpos = mul_p(itrans, pos);
+                    float3 rdir = normalize(mul_v(itrans, ray_dir[i]));
+                    int ti;
+                    float d;
+                    if (bvh.raycast(rpos, rdir, ti, d)) {
+                        d = length(mul_p(transforms[ii], rpos + rdir * d) - pos);
+                        if (d < distance) {
+                            instance = ii;
+                            tindex = ti;
+                            distance = d;
+                        }
+                    }
+                }
+
+                SceneBVH::Hit hit;
+                bool h = scene.raycast(pos, ray_dir[i], hit);
+                if (h != (instance != -1) ||
+                    (h && (hit.instance != instance || hit.tindex != tindex || !near_equal(hit.distance, distance, 1e-4f))))
+                {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        TestScope("scene build", [&]() {
+            scene.build(blas.data(), transforms.data(), num_instances);
+        });
+        TestScope("scene raycast", [&]() {
+            SceneBVH::Hit hit;
+            for (int i = 0; i < num_rays; ++i) {
+                scene.raycast(ray_pos[i] + float3{ float(i % 7) - 3.0f, 0.0f, float(i % 5) - 2.0f }, ray_dir[i], hit);
+            }
+        });
+        if (!validate()) {
+            Print("    *** validation failed ***\n");
+        }
+
+        for (int i = 0; i < num_instances; ++i) {
+            transforms[i] = transform(float3{ 0.0f, float(i) * -0.1f, 0.0f }, rotateY(i * -0.2f), float3::one()) * transforms[i];
+        }
+        TestScope("scene refit", [&]() {
+            scene.refit(transforms.data());
+        });
+        if (!validate()) {
+            Print("    *** validation failed ***\n");
+        }
+    }
+
+    // rays from inside of a sphere must hit only triangles gathered by sweeping the sphere
+    {
+        const float3 center = { 0.2f, 2.0f, -0.3f }, dir = { 0.0f, -1.0f, 0.0f };
+        const float radius = 0.15f;
+        RawVector<int> swept;
+        TestScope("BVH gather swept", [&]() {
+            bvh.gatherSwept(center, radius, dir, swept);
+        });
+        Print("        %d triangles\n", (int)swept.size());
+        for (int i = 0; i < 100; ++i) {
+            float a = i * 0.7f, r = radius * float(i % 10) / 10.0f;
+            float3 pos = center + float3{ std::sin(a) * r, 0.0f, std::cos(a) * r };
+            int ti;
+            float distance;
+            if (RayTrianglesIntersectionIndexed(pos, dir, points.data(), indices.data(), num_triangles, ti, distance) &&
+                !std::binary_search(swept.begin(), swept.end(), ti))
+            {
+                Print("    *** validation failed ***\n");
+                break;
+            }
+        }
+    }
+
+    // nearest points from points around the mesh
+    {
+        const int num_points = 1000;
+        RawVector<float3> qpos;
+        RawVector<TriangleBVH::Hit> nearest1, nearest2;
+        qpos.resize(num_points); nearest1.resize(num_points); nearest2.resize(num_points);
+        for (int i = 0; i < num_points; ++i) {
+            float a = i * 0.37f;
+            qpos[i] = { std::sin(a) * 1.2f, std::cos(a * 1.3f) * 0.4f, std::cos(a) * 1.2f };
+        }
+
+        TestScope("closest point brute force", [&]() {
+            for (int i = 0; i < num_points; ++i) {
+                float best = std::numeric_limits<float>::max();
+                for (int ti = 0; ti < num_triangles; ++ti) {
+                    float u, v;
+                    float3 d = closest_point_on_triangle(qpos[i],
+                        points[indices[ti * 3 + 0]], points[indices[ti * 3 + 1]], points[indices[ti * 3 + 2]], u, v) - qpos[i];
+                    if (dot(d, d) < best) {
+                        best = dot(d, d);
+                        nearest1[i].tindex = ti;
+                        nearest1[i].distance = std::sqrt(best);
+                    }
+                }
+            }
+        });
+        TestScope("closest point BVH", [&]() {
+            bvh.closestPoint(qpos.data(), num_points, std::numeric_limits<float>::max(), nearest2.data());
+        });
+        for (int i = 0; i < num_points; ++i) {
+            if (!near_equal(nearest1[i].distance, nearest2[i].distance)) {
+                Print("    *** validation failed ***\n");
+                break;
+            }
+        }
+
+        // non-uniform scale and shear: the local BVH is searched in the transformed space
+        float4x4 trans = float4x4::identity();
+        trans[0][0] = 2.0f; trans[1][1] = 0.5f; trans[1][0] = 0.7f; trans[3][2] = 0.3f;
+        RawVector<float3> tpoints;
+        tpoints.resize_discard(points.size());
+        for (size_t i = 0; i < points.size(); ++i) {
+            tpoints[i] = mul_p(trans, points[i]);
+        }
+        TestScope("closest point transformed brute force", [&]() {
+            for (int i = 0; i < num_points; ++i) {
+                float best = std::numeric_limits<float>::max();
+                for (int ti = 0; ti < num_triangles; ++ti) {
+                    float u, v;
+                    float3 d = closest_point_on_triangle(qpos[i],
+                        tpoints[indices[ti * 3 + 0]], tpoints[indices[ti * 3 + 1]], tpoints[indices[ti * 3 + 2]], u, v) - qpos[i];
+                    if (dot(d, d) < best) {
+                        best = dot(d, d);
+                        nearest1[i].tindex = ti;
+                        nearest1[i].distance = std::sqrt(best);
+                    }
+                }
+            }
+        });
+        TestScope("closest point transformed BVH", [&]() {
+            bvh.closestPoint(qpos.data(), num_points, trans, std::numeric_limits<float>::max(), nearest2.data());
+        });
+        for (int i = 0; i < num_points; ++i) {
+            if (nearest1[i].tindex != nearest2[i].tindex || nearest1[i].distance != nearest2[i].distance) {
+                Print("    *** validation failed ***\n");
+                break;
+            }
+        }
+    }
+
+    // visibility of vertices from a low viewpoint
+    const int num_targets = 1000;
+    const float3 eye = { 1.5f, 0.3f, 0.2f };
+    int num_vertices = (int)points.size();
+    RawVector<int> occluded1, occluded2, occluded3;
+    occluded1.resize_zeroclear(num_targets); occluded2.resize_zeroclear(num_targets); occluded3.resize_zeroclear(num_targets);
+    auto TargetRay = [&](int i, float3& dir, float& max_distance) -> int {
+        int vi = int((int64_t)i * 7919 % num_vertices);
+        float3 d = points[vi] - eye;
+        max_distance = length(d) - 0.01f;
+        dir = d / length(d);
+        return vi;
+    };
+
+    TestScope("occlusion brute force", [&]() {
+        for (int i = 0; i < num_targets; ++i) {
+            float3 dir; float max_distance;
+            int vi = TargetRay(i, dir, max_distance);
+            occluded1[i] = RayTrianglesOcclusionIndexed_Generic(eye, dir, points.data(), indices.data(), num_triangles, vi, max_distance);
+        }
+    });
+
+#ifdef muSIMD_RayTrianglesOcclusionIndexed
+    TestScope("occlusion brute force ISPC", [&]() {
+        for (int i = 0; i < num_targets; ++i) {
+            float3 dir; float max_distance;
+            int vi = TargetRay(i, dir, max_distance);
+            occluded3[i] = RayTrianglesOcclusionIndexed_ISPC(eye, dir, points.data(), indices.data(), num_triangles, vi, max_distance);
+        }
+    });
+    if (!std::equal(occluded1.begin(), occluded1.end(), occluded3.begin())) {
+        Print("    *** validation failed ***\n");
+    }
+#endif
+
+    TestScope("occlusion BVH", [&]() {
+        for (int i = 0; i < num_targets; ++i) {
+            float3 dir; float max_distance;
+            int vi = TargetRay(i, dir, max_distance);
+            occluded2[i] = bvh.occluded(eye, dir, max_distance, indices.data(), vi);
+        }
+    });
+    Print("        %d / %d occluded\n", (int)std::count(occluded2.begin(), occluded2.end(), 1), num_targets);
+    if (!std::equal(occluded1.begin(), occluded1.end(), occluded2.begin())) {
+        Print("    *** validation failed ***\n");
+    }
+
+    RawVector<float3> target_pos, target_dir;
+    RawVector<float> target_distance;
+    RawVector<int> target_vertex;
+    RawVector<bool> occluded4;
+    target_pos.resize(num_targets); target_dir.resize(num_targets); target_distance.resize(num_targets);
+    target_vertex.resize(num_targets); occluded4.resize(num_targets);
+    for (int i = 0; i < num_targets; ++i) {
+        target_pos[i] = eye;
+        target_vertex[i] = TargetRay(i, target_dir[i], target_distance[i]);
+    }
+    TestScope("occlusion BVH batched", [&]() {
+        bvh.occluded(target_pos.data(), target_dir.data(), target_distance.data(), target_vertex.data(), num_targets,
+            indices.data(), occluded4.data());
+    });
+    for (int i = 0; i < num_targets; ++i) {
+        if ((occluded1[i] != 0) != occluded4[i]) {
+            Print("    *** validation failed ***\n");
+            break;
+        }
+    }
+}
+
+
+TestCase(TestPointGrid)
+{
+    RawVector<int> counts, indices;
+    RawVector<float3> points;
+    RawVector<float2> uv;
+    GenerateWaveMesh(counts, indices, points, uv, 2.0f, 0.5f, 256, 0.0f, true);
+    int num_points = (int)points.size();
+
+    PointGrid grid;
+    TestScope("build", [&]() {
+        grid.build(points);
+    });
+    Print("    %d points, %d x %d x %d cells\n", num_points, grid.dim[0], grid.dim[1], grid.dim[2]);
+
+    const int num_queries = 200;
+    RawVector<int> result1, result2;
+    double brute_force = 0.0, with_grid = 0.0;
+    for (int qi = 0; qi < num_queries; ++qi) {
+        float a = qi * 0.37f;
+        float3 pos = { std::sin(a) * 1.1f, std::cos(a * 1.7f) * 0.3f, std::cos(a) * 0.9f };
+        float radius = 0.01f + (qi % 10) * 0.03f + (qi % 50 == 0 ? 2.0f : 0.0f);
+
+        auto t0 = Now();
+        result1.clear();
+        for (int pi = 0; pi < num_points; ++pi) {
+            if (length_sq(points[pi] - pos) <= radius * radius) {
+                result1.push_back(pi);
+            }
+        }
+        auto t1 = Now();
+        grid.gather(pos, radius, result2);
+        auto t2 = Now();
+        brute_force += NS2MS(t1 - t0);
+        with_grid += NS2MS(t2 - t1);
+
+        if (result1.size() != result2.size() || !std::equal(result1.begin(), result1.end(), result2.begin())) {
+            Print("    *** validation failed ***\n");
+            break;
+        }
+    }
+    Print("    %d queries: brute force %.2fms, grid %.2fms\n", num_queries, brute_force, with_grid);
+
+    // strokes: points within radius of polylines. the last one covers most of the grid
+    for (int si = 0; si < 4; ++si) {
+        RawVector<float3> path;
+        int num_path = si == 0 ? 1 : 5 + si * 20;
+        float radius = si == 3 ? 1.5f : 0.02f + si * 0.02f;
+        for (int i = 0; i < num_path; ++i) {
+            path.push_back(points[(si * 9973 + i * 3) % num_points]);
+        }
+
+        result1.clear();
+        for (int pi = 0; pi < num_points; ++pi) {
+            for (int i = 0; i < std::max(num_path - 1, 1); ++i) {
+                float3 a = path[i], b = path[std::min(i + 1, num_path - 1)];
+                float3 ab = b - a;
+                float lq = length_sq(ab);
+                float t = lq > 0.0f ? clamp01(dot(points[pi] - a, ab) / lq) : 0.0f;
+                if (length_sq(a + ab * t - points[pi]) <= radius * radius) {
+                    result1.push_back(pi);
+                    break;
+                }
+            }
+        }
+        TestScope("gather swept", [&]() {
+            grid.gatherSwept(path.data(), num_path, radius, result2);
+        });
+        Print("        %d segments: %d points\n", num_path - 1, (int)result2.size());
+        if (result1.size() != result2.size() || !std::equal(result1.begin(), result1.end(), result2.begin())) {
+            Print("    *** validation failed ***\n");
+        }
+    }
+
+    // non-finite points stay in the grid but never match a finite query
+    {
+        const float inf = std::numeric_limits<float>::infinity();
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        RawVector<float3> broken;
+        broken.assign(points.begin(), points.begin() + 1000);
+        broken[3] = { nan, 0.0f, 0.0f };
+        broken[500] = { inf, -inf, 0.0f };
+        broken[999] = { 0.0f, 0.0f, 3e38f };
+
+        PointGrid bgrid;
+        bgrid.build(broken);
+        bgrid.gather(broken[0], 0.5f, result2);
+        if (std::find(result2.begin(), result2.end(), 3) != result2.end() ||
+            std::find(result2.begin(), result2.end(), 500) != result2.end() ||
+            std::find(result2.begin(), result2.end(), 0) == result2.end())
+        {
+            Print("    *** validation failed ***\n");
+        }
+        bgrid.gather({ nan, nan, nan }, 0.5f, result2);
+        if (!result2.empty()) {
+            Print("    *** validation failed ***\n");
+        }
+    }
+
+    // coincident points: every vertex of each triangle is duplicated, and some are shifted slightly
+    {
+        const float eps = 1e-4f;
+        RawVector<float3> flattened;
+        for (int i = 0; i < (int)indices.size(); i += 3) {
+            for (int j = 0; j < 3; ++j) {
+                float3 p = points[indices[i + j]];
+                if (i % 7 == 0) { p.x += eps * 0.7f; }
+                flattened.push_back(p);
+            }
+        }
+        int num_flattened = (int)flattened.size();
+
+        PointHashGrid hgrid;
+        TestScope("hash grid build", [&]() {
+            hgrid.build(flattened, eps);
+        });
+        Print("    %d points, %d cells\n", num_flattened, (int)hgrid.cells.size());
+
+        RawVector<int> offsets, neighbors;
+        TestScope("hash grid gather all", [&]() {
+            hgrid.gatherAll(offsets, neighbors);
+        });
+
+        for (int pi = 0; pi < num_flattened; pi += 101) {
+            result1.clear();
+            for (int i = 0; i < num_flattened; ++i) {
+                if (length(flattened[i] - flattened[pi]) < eps) {
+                    result1.push_back(i);
+                }
+            }
+            hgrid.gather(flattened[pi], result2);
+            if (result1.size() != result2.size() || !std::equal(result1.begin(), result1.end(), result2.begin()) ||
+                result1.size() != (size_t)(offsets[pi + 1] - offsets[pi]) || !std::equal(result1.begin(), result1.end(), &neighbors[offsets[pi]]))
+            {
+                Print("    *** validation failed ***\n");
+                break;
+            }
+        }
+
+        // non-finite points have no cell and no neighbors, not even themselves
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        flattened[1] = { nan, 0.0f, 0.0f };
+        flattened[2] = { std::numeric_limits<float>::infinity(), 0.0f, 0.0f };
+        flattened[4] = { 3e38f, -3e38f, 0.0f };
+        hgrid.build(flattened, eps);
+        hgrid.gatherAll(offsets, neighbors);
+        hgrid.gather({ nan, nan, nan }, result2);
+        if (offsets[2] != offsets[1] || offsets[3] != offsets[2] || offsets[5] - offsets[4] != 1 || !result2.empty()) {
+            Print("    *** validation failed ***\n");
+        }
+    }
+}
+
+TestCase(TestDepthBuffer)
+{
+    RawVector<int> counts, indices;
+    RawVector<float3> points;
+    RawVector<float2> uv;
+    GenerateWaveMesh(counts, indices, points, uv, 2.0f, 0.5f, 256, 0.0f, true);
+
+    // perspective camera looking at the wave mesh
+    const float3 eye = { 1.5f, 1.0f, 1.5f };
+    const float fo = 1.0f / std::tan(30.0f * Deg2Rad), n = 0.1f, f = 100.0f;
+    float3 forward = normalize(float3{ 0.0f, 0.0f, 0.0f } - eye);
+    float3 right = normalize(cross(forward, float3{ 0.0f, 1.0f, 0.0f }));
+    float3 up = cross(right, forward);
+    float4x4 view = look_at(eye, float3{ 0.0f, 0.0f, 0.0f }, float3{ 0.0f, 1.0f, 0.0f });
+    auto to_clip = [&](float3 v, float w) {
+        float3 p = w == 1.0f ? mul_p(view, v) : mul_v(view, v);
+        return float4{ fo * p.x, fo * p.y, -(f + n) / (f - n) * p.z - 2.0f * f * n / (f - n) * w, -p.z };
+    };
+    float4x4 mvp;
+    mvp[0] = to_clip({ 1.0f, 0.0f, 0.0f }, 0.0f);
+    mvp[1] = to_clip({ 0.0f, 1.0f, 0.0f }, 0.0f);
+    mvp[2] = to_clip({ 0.0f, 0.0f, 1.0f }, 0.0f);
+    mvp[3] = to_clip({ 0.0f, 0.0f, 0.0f }, 1.0f);
+
+    const int size = 256;
+    DepthBuffer dbuf;
+    TestScope("DepthBuffer build", [&]() {
+        dbuf.build(mvp, eye, indices, points, size, size);
+    });
+
+    // front-most triangles must match raycasts through pixel centers except at edges of triangles.
+    // visibility doesn't depend on them alone, so it is checked separately below and must match exactly.
+    TriangleBVH bvh;
+    bvh.build(indices, points);
+    int num_covered = 0, num_mismatch = 0;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            float2 ndc = { (x + 0.5f) / size * 2.0f - 1.0f, (y + 0.5f) / size * 2.0f - 1.0f };
+            float3 dir = normalize(right * (ndc.x / fo) + up * (ndc.y / fo) + forward);
+            int ti;
+            float distance;
+            if (!bvh.raycast(eye, dir, ti, distance)) { ti = -1; }
+            int ti2 = dbuf.getTriangle(x, y);
+            if (ti2 != -1) { ++num_covered; }
+            if (ti != ti2) { ++num_mismatch; }
+        }
+    }
+    Print("    %d pixels covered, %d mismatch\n", num_covered, num_mismatch);
+    if (num_covered == 0 || num_mismatch > num_covered / 100) {
+        Print("    *** validation failed ***\n");
+    }
+
+    // triangles that block the ray from the eye to a vertex cover the vertex on the screen, so they are in the tile of
+    // its pixel. visibility decided by tiles must match occlusion queries exactly, unlike front-most triangles above.
+    int num_tested = 0, num_occluded = 0, num_vis_mismatch = 0;
+    TestScope("visibility by tiles", [&]() {
+        for (int vi = 0; vi < (int)points.size(); ++vi) {
+            float4 vp = mul4(mvp, points[vi]);
+            int x, y;
+            if (!dbuf.getPixel(vp, x, y)) { continue; }
+
+            float3 d = points[vi] - eye;
+            float distance = length(d);
+            float3 dir = d / distance;
+            float max_distance = distance - 0.01f;
+            auto blocks = [&](int ti) {
+                int i1 = indices[ti * 3 + 0], i2 = indices[ti * 3 + 1], i3 = indices[ti * 3 + 2];
+                float t;
+                return i1 != vi && i2 != vi && i3 != vi &&
+                    ray_triangle_intersection(eye, dir, points[i1], points[i2], points[i3], t) && t < max_distance;
+            };
+            bool blocked = false;
+            const int *tris;
+            int n = dbuf.getTileTriangles(x, y, tris);
+            for (int i = 0; i < n && !blocked && dbuf.near_w[tris[i]] < vp.w; ++i) { blocked = blocks(tris[i]); }
+            for (int i = 0; i < (int)dbuf.near_triangles.size() && !blocked; ++i) { blocked = blocks(dbuf.near_triangles[i]); }
+
+            bool occluded = bvh.occluded(eye, dir, max_distance, indices.data(), vi);
+            ++num_tested;
+            if (occluded) { ++num_occluded; }
+            if (blocked != occluded) { ++num_vis_mismatch; }
+        }
+    });
+    Print("    %d vertices tested, %d occluded, %d mismatch\n", num_tested, num_occluded, num_vis_mismatch);
+    if (num_tested == 0 || num_occluded == 0 || num_vis_mismatch != 0) {
+        Print("    *** validation failed ***\n");
+    }
+}
 
 TestCase(TestPolygonInside)
 {
@@ -552,6 +1229,53 @@ TestCase(TestPolygonInside)
     }, num_try);
     PrintResult();
 #endif
+
+    {
+        // freehand-like lasso with self intersections
+        const int num_lasso = 500;
+        RawVector<float2> lasso(num_lasso);
+        for (int i = 0; i < num_lasso; ++i) {
+            float a = (360.0f / num_lasso) * i * Deg2Rad;
+            float r = 0.5f + 0.3f * std::sin(a * 7.0f) + 0.05f * std::sin(a * 31.0f);
+            lasso[i] = { std::cos(a) * r * 1.3f + std::sin(a * 2.0f) * 0.3f, std::sin(a) * r };
+        }
+        MinMax(lasso.data(), num_lasso, pmin, pmax);
+
+        const int div = 512;
+        RawVector<float2> queries;
+        for (int yi = 0; yi < div; ++yi) {
+            for (int xi = 0; xi < div; ++xi) {
+                queries.push_back({ ((float)xi / div - 0.5f) * 2.5f, ((float)yi / div - 0.5f) * 2.5f });
+            }
+        }
+        for (auto& p : lasso) { queries.push_back(p); }
+
+        PolygonMask mask;
+        TestScope("PolygonMask build", [&]() {
+            mask.build(lasso.data(), num_lasso, 1024);
+        });
+
+        RawVector<char> result1(queries.size()), result2(queries.size());
+        TestScope("PolyInside", [&]() {
+            for (size_t i = 0; i < queries.size(); ++i) {
+                result1[i] = PolyInside(lasso.data(), num_lasso, pmin, pmax, queries[i]);
+            }
+        });
+        TestScope("PolygonMask", [&]() {
+            for (size_t i = 0; i < queries.size(); ++i) {
+                result2[i] = mask.inside(queries[i]);
+            }
+        });
+        num_inside = 0;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            if (result1[i] != result2[i]) {
+                Print("    *** validation failed ***\n");
+                break;
+            }
+            if (result2[i]) { ++num_inside; }
+        }
+        PrintResult();
+    }
 }
 
 
@@ -644,4 +1368,135 @@ TestCase(TestEdge)
         }
         Print("\n");
     }
+    Print("\n");
+
+    {
+        // unshared grid: each triangle has its own vertices
+        const int div = 64;
+        RawVector<float3> points;
+        RawVector<int> indices;
+        for (int yi = 0; yi < div; ++yi) {
+            for (int xi = 0; xi < div; ++xi) {
+                float3 p[4] = {
+                    { (float)xi, 0.0f, (float)yi }, { (float)xi + 1, 0.0f, (float)yi },
+                    { (float)xi + 1, 0.0f, (float)yi + 1 }, { (float)xi, 0.0f, (float)yi + 1 },
+                };
+                int t[6] = { 0, 1, 2, 0, 2, 3 };
+                for (int i : t) {
+                    indices.push_back((int)points.size());
+                    points.push_back(p[i]);
+                }
+            }
+        }
+
+        ConnectionData connection;
+        TestScope("build connection with welding", [&]() {
+            connection.buildConnection(indices, 3, points, true);
+        });
+
+        int num_points = (int)points.size();
+        int num_welded = 0;
+        for (int vi = 0; vi < num_points; ++vi) {
+            int r = vi;
+            for (int i = 0; i < vi; ++i) {
+                if (length(points[i] - points[vi]) < 0.0000001f) {
+                    r = i;
+                    break;
+                }
+            }
+            if (connection.weld_map[vi] != r) {
+                Print("    *** validation failed ***\n");
+                break;
+            }
+            if (r == vi) { ++num_welded; }
+        }
+        Print("    %d vertices -> %d welded vertices\n", num_points, num_welded);
+
+        // welded grid has one boundary loop around it and is connected. unwelded, each triangle is a loop and a component.
+        // vertices that are welded into others are left isolated in the welded table.
+        EdgeTable edges, welded_edges;
+        TestScope("build edge table", [&]() {
+            edges.build(indices, 3, num_points);
+        });
+        TestScope("build welded edge table", [&]() {
+            welded_edges.buildWelded(indices, 3, connection.weld_map);
+        });
+        if (edges.numLoops() != (int)indices.size() / 3 ||
+            welded_edges.numLoops() != 1 ||
+            welded_edges.loop_offsets[1] != div * 4 ||
+            edges.numComponents() != (int)indices.size() / 3 ||
+            welded_edges.numComponents() != 1 + num_points - num_welded)
+        {
+            Print("    *** validation failed ***\n");
+        }
+
+        int num_hole = 0;
+        int vi[] = { 0 };
+        SelectHole(welded_edges, connection, vi, [&](int) { ++num_hole; });
+        int num_connected = 0;
+        SelectConnected(edges, vi, [&](int) { ++num_connected; });
+        Print("    %d loops, %d welded loops, %d vertices on hole, %d connected vertices\n",
+            edges.numLoops(), welded_edges.numLoops(), num_hole, num_connected);
+    }
+}
+
+TestCase(TestGeodesicFront)
+{
+    // jittered grid with diagonals in alternating directions. irregular enough for the shortcut over two edges
+    // to find shorter paths to vertices that are already queued.
+    const int div = 64;
+    const int num_points = (div + 1) * (div + 1);
+    RawVector<float3> points(num_points);
+    RawVector<int> indices;
+    for (int yi = 0; yi <= div; ++yi) {
+        for (int xi = 0; xi <= div; ++xi) {
+            float jx = std::sin(xi * 12.9898f + yi * 78.233f) * 0.3f;
+            float jz = std::sin(xi * 39.3468f + yi * 11.135f) * 0.3f;
+            points[(div + 1) * yi + xi] = { (float)xi + jx, 0.0f, (float)yi + jz };
+        }
+    }
+    for (int yi = 0; yi < div; ++yi) {
+        for (int xi = 0; xi < div; ++xi) {
+            int i00 = (div + 1) * yi + xi, i10 = i00 + 1, i01 = i00 + (div + 1), i11 = i01 + 1;
+            if ((xi * 7 + yi * 3) % 5 < 2) {
+                int t[] = { i00, i01, i11, i00, i11, i10 };
+                for (int i : t) { indices.push_back(i); }
+            }
+            else {
+                int t[] = { i00, i01, i10, i10, i01, i11 };
+                for (int i : t) { indices.push_back(i); }
+            }
+        }
+    }
+
+    EdgeTable edges;
+    edges.build(indices, 3, num_points);
+
+    GeodesicFront front;
+    int seeds[] = { (div + 1) * (div / 2) + div / 2 };
+    float3 origin = points[seeds[0]];
+    auto position = [&](int vi) { return points[vi]; };
+    for (int run = 0; run < 2; ++run) {
+        float max_distance = run == 0 ? 20.0f : 10.0f;
+        TestScope("GeodesicFront::run", [&]() {
+            front.run(edges, seeds, 1, origin, max_distance, position);
+        });
+
+        RawVector<int> count(num_points);
+        count.zeroclear();
+        bool ok = !front.settled.empty();
+        float prev = 0.0f;
+        for (auto& s : front.settled) {
+            if (++count[s.first] > 1 || s.second < prev || s.second > max_distance ||
+                s.second < length(points[s.first] - origin) - 1e-4f)
+            {
+                ok = false;
+            }
+            prev = s.second;
+        }
+        Print("    %d vertices settled within %.1f\n", (int)front.settled.size(), max_distance);
+        if (!ok) {
+            Print("    *** validation failed ***\n");
+        }
+    }
 }
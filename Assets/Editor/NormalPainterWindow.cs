@@ -213,6 +213,7 @@ namespace UTJ.NormalPainterEditor
         static readonly string[] strProjectionMode = new string[] {
             "Directional",
             "Use Normals As Ray",
+            "Nearest",
         };
         static readonly string[] strRaySourcee = new string[] {
             "Base Normals",
@@ -327,6 +328,7 @@ namespace UTJ.NormalPainterEditor
                 EditorGUILayout.Space();
                 if (settings.selectMode == SelectMode.Brush)
                 {
+                    settings.brushFalloff = (BrushFalloff)EditorGUILayout.EnumPopup("Falloff", settings.brushFalloff); EditorGUILayout.Space();
                     DrawBrushPanel();
                 }
                 else
@@ -404,7 +406,9 @@ namespace UTJ.NormalPainterEditor
                 settings.brushMode = (BrushMode)GUILayout.SelectionGrid((int)settings.brushMode, strBrushTypes, 5);
                 EditorGUILayout.Space();
 
-                settings.brushMaskWithSelection = EditorGUILayout.Toggle("Mask With Selection", settings.brushMaskWithSelection); EditorGUILayout.Space();
+                settings.brushMaskWithSelection = EditorGUILayout.Toggle("Mask With Selection", settings.brushMaskWithSelection);
+                settings.brushFalloff = (BrushFalloff)EditorGUILayout.EnumPopup("Falloff", settings.brushFalloff);
+                settings.brushSpacing = EditorGUILayout.Slider("Spacing", settings.brushSpacing, 0.05f, 1.0f); EditorGUILayout.Space();
                 DrawBrushPanel();
 
                 if (settings.brushMode == BrushMode.Replace)
@@ -574,6 +578,10 @@ namespace UTJ.NormalPainterEditor
                     {
                         m_target.ApplyProjection2(normalSource, settings.projectionDir, true);
                     }
+                    else if (settings.projectionMode == 2)
+                    {
+                        m_target.ApplyProjectionNearest(normalSource, true);
+                    }
                     else
                     {
                         var rayDirs = settings.projectionRayDir == 0 ?
@@ -620,8 +628,20 @@ namespace UTJ.NormalPainterEditor
             EditorGUILayout.BeginVertical();
             {
                 var mirrorMode = settings.mirrorMode;
+                var mirrorTolerance = settings.mirrorTolerance;
+                var mirrorEpsilon = settings.mirrorEpsilon;
                 settings.mirrorMode = (MirrorMode)EditorGUILayout.EnumPopup("Mirroring", settings.mirrorMode);
-                if (mirrorMode != settings.mirrorMode)
+                if (settings.mirrorMode != MirrorMode.None)
+                {
+                    EditorGUI.indentLevel++;
+                    settings.mirrorTolerance = (MirrorTolerance)EditorGUILayout.EnumPopup("Tolerance", settings.mirrorTolerance);
+                    if (settings.mirrorTolerance != MirrorTolerance.Exact)
+                        settings.mirrorEpsilon = EditorGUILayout.FloatField("Epsilon", settings.mirrorEpsilon);
+                    EditorGUI.indentLevel--;
+                }
+                if (mirrorMode != settings.mirrorMode ||
+                    mirrorTolerance != settings.mirrorTolerance ||
+                    mirrorEpsilon != settings.mirrorEpsilon)
                 {
                     m_target.ApplyMirroring(true);
                 }
@@ -84,6 +84,10 @@ namespace UTJ.NormalPainter
         Vector2 m_rectEndPoint;
         List<Vector2> m_lassoPoints = new List<Vector2>();
         int m_brushNumPainted = 0;
+        bool m_brushStroking = false;
+        Vector3 m_brushLastDab;
+        Vector3 m_brushLastValue;
+        float m_brushLastPressure = 1.0f;
 
         [SerializeField] History m_history = new History();
         int m_historyIndex = 0;
@@ -120,6 +124,7 @@ namespace UTJ.NormalPainter
                 if (value != null && value.Length == m_selection.Count)
                 {
                     Array.Copy(value, m_selection.Array, m_selection.Count);
+                    ResetSelectionIndex();
                     UpdateSelection();
                 }
             }
@@ -347,15 +352,25 @@ namespace UTJ.NormalPainter
 
             m_settings.InitializeBrushData();
 
+            ReleaseMeshCache();
+            m_npModelData.cache = CreateMeshCache();
+
             UpdateTransform();
             UpdateNormals();
             PushUndo();
             m_editing = true;
+            if (!s_editingPainters.Contains(this))
+                s_editingPainters.Add(this);
         }
 
         void EndEdit()
         {
+            s_editingPainters.Remove(this);
+            if (s_editingPainters.Count == 0)
+                ReleaseScene();
+
             ReleaseComputeBuffers();
+            ReleaseMeshCache();
             if(m_settings) m_settings.projectionNormalSource = null;
 
             m_editing = false;
@@ -375,6 +390,15 @@ namespace UTJ.NormalPainter
             if (m_cmdDraw != null) { m_cmdDraw.Release(); m_cmdDraw = null; }
         }
 
+        void ReleaseMeshCache()
+        {
+            if (m_npModelData.cache != IntPtr.Zero)
+            {
+                npDestroyMeshCache(m_npModelData.cache);
+                m_npModelData.cache = IntPtr.Zero;
+            }
+        }
+
         void Start()
         {
             npInitializePenInput();
@@ -583,6 +607,8 @@ namespace UTJ.NormalPainter
         {
             if (e.alt) return 0;
 
+            SetBrushFalloff(m_settings.brushFalloff);
+
             int ret = 0;
             var editMode = m_settings.editMode;
             bool handled = false;
@@ -598,54 +624,77 @@ namespace UTJ.NormalPainter
             }
             else if (editMode == EditMode.Brush)
             {
+                // a stroke is continued from the last dab only while the cursor stays on the model
+                if (!m_rayHit || et == EventType.MouseDown)
+                    m_brushStroking = false;
+
                 if (m_rayHit && (et == EventType.MouseDown || et == EventType.MouseDrag) && (!e.shift && !e.control))
                 {
                     var bd = m_settings.activeBrush;
-                    switch (m_settings.brushMode)
+                    if (et == EventType.MouseDrag && m_brushStroking && m_settings.brushMode != BrushMode.Projection &&
+                        HasEntryPoint("npBrushStroke"))
                     {
-                    case BrushMode.Flow:
-                        if (ApplyFlowBrush(m_settings.brushMaskWithSelection, m_rayPos, m_prevRayPos, bd.radius, bd.strength, bd.samples,
-                                PickBaseNormal(m_rayPos, m_rayHitTriangle)))
-                                ++m_brushNumPainted;
-                            break;
-                        case BrushMode.Paint:
-                            if (ApplyPaintBrush(m_settings.brushMaskWithSelection, m_rayPos, bd.radius, bd.strength, bd.samples,
-                                PickBaseNormal(m_rayPos, m_rayHitTriangle), settings.brushBlendMode))
-                                ++m_brushNumPainted;
-                            break;
-                        case BrushMode.Replace:
-                            if (ApplyReplaceBrush(m_settings.brushMaskWithSelection, m_rayPos, bd.radius, bd.strength, bd.samples,
-                                m_settings.assignValue))
-                                ++m_brushNumPainted;
-                            break;
-                        case BrushMode.Smooth:
-                            if (ApplySmoothBrush(m_settings.brushMaskWithSelection, m_rayPos, bd.radius, bd.strength, bd.samples))
-                                ++m_brushNumPainted;
-                            break;
-                        case BrushMode.Projection:
-                            if (m_settings.projectionNormalSourceData == null || m_settings.projectionNormalSourceData.empty)
-                            {
-                                if (et == EventType.MouseDown)
-                                    Debug.LogError("\"Normal Source\" object is not set or has no readable Mesh or Terrain.");
-                            }
-                            else if (settings.projectionMode == 0)
-                            {
-                                if (ApplyProjectionBrush2(m_settings.brushMaskWithSelection, m_rayPos, bd.radius, bd.strength, bd.samples,
-                                    m_settings.projectionNormalSourceData, settings.projectionDir))
+                        // dabs from the last dab to the cursor are placed and applied natively in one call
+                        if (ApplyBrushStroke(m_settings.brushMode, m_settings.brushMaskWithSelection, m_rayPos, bd.radius, bd.strength, bd.samples,
+                                GetBrushStrokeValue(), settings.brushBlendMode))
+                            ++m_brushNumPainted;
+                    }
+                    else
+                    {
+                        // the first dab is scaled by pressure as following dabs placed by ApplyBrushStroke() are
+                        BeginBrushStroke(m_rayPos, GetBrushStrokeValue());
+                        float strength = bd.strength * m_brushLastPressure;
+                        switch (m_settings.brushMode)
+                        {
+                            case BrushMode.Flow:
+                                if (ApplyFlowBrush(m_settings.brushMaskWithSelection, m_rayPos, m_prevRayPos, bd.radius, strength, bd.samples,
+                                    PickBaseNormal(m_rayPos, m_rayHitTriangle)))
                                     ++m_brushNumPainted;
-                            }
-                            else
-                            {
-                                var rayDirs = settings.projectionRayDir == 0 ? m_normalsBase : m_normals;
-                                if (ApplyProjectionBrush(m_settings.brushMaskWithSelection, m_rayPos, bd.radius, bd.strength, bd.samples,
-                                    m_settings.projectionNormalSourceData, rayDirs))
+                                break;
+                            case BrushMode.Paint:
+                                if (ApplyPaintBrush(m_settings.brushMaskWithSelection, m_rayPos, bd.radius, strength, bd.samples,
+                                    PickBaseNormal(m_rayPos, m_rayHitTriangle), settings.brushBlendMode))
                                     ++m_brushNumPainted;
-                            }
-                            break;
-                        case BrushMode.Reset:
-                            if (ApplyResetBrush(m_settings.brushMaskWithSelection, m_rayPos, bd.radius, bd.strength, bd.samples))
-                                ++m_brushNumPainted;
-                            break;
+                                break;
+                            case BrushMode.Replace:
+                                if (ApplyReplaceBrush(m_settings.brushMaskWithSelection, m_rayPos, bd.radius, strength, bd.samples,
+                                    m_settings.assignValue))
+                                    ++m_brushNumPainted;
+                                break;
+                            case BrushMode.Smooth:
+                                if (ApplySmoothBrush(m_settings.brushMaskWithSelection, m_rayPos, bd.radius, strength, bd.samples))
+                                    ++m_brushNumPainted;
+                                break;
+                            case BrushMode.Projection:
+                                if (m_settings.projectionNormalSourceData == null || m_settings.projectionNormalSourceData.empty)
+                                {
+                                    if (et == EventType.MouseDown)
+                                        Debug.LogError("\"Normal Source\" object is not set or has no readable Mesh or Terrain.");
+                                }
+                                else if (settings.projectionMode == 0)
+                                {
+                                    if (ApplyProjectionBrush2(m_settings.brushMaskWithSelection, m_rayPos, bd.radius, bd.strength, bd.samples,
+                                        m_settings.projectionNormalSourceData, settings.projectionDir))
+                                        ++m_brushNumPainted;
+                                }
+                                else if (settings.projectionMode == 2)
+                                {
+                                    if (et == EventType.MouseDown)
+                                        Debug.LogError("\"Nearest\" projection mode is not supported by the projection brush.");
+                                }
+                                else
+                                {
+                                    var rayDirs = settings.projectionRayDir == 0 ? m_normalsBase : m_normals;
+                                    if (ApplyProjectionBrush(m_settings.brushMaskWithSelection, m_rayPos, bd.radius, bd.strength, bd.samples,
+                                        m_settings.projectionNormalSourceData, rayDirs))
+                                        ++m_brushNumPainted;
+                                }
+                                break;
+                            case BrushMode.Reset:
+                                if (ApplyResetBrush(m_settings.brushMaskWithSelection, m_rayPos, bd.radius, strength, bd.samples))
+                                    ++m_brushNumPainted;
+                                break;
+                        }
                     }
                     handled = true;
                 }
@@ -668,7 +717,7 @@ namespace UTJ.NormalPainter
                 if (selectMode == SelectMode.Single)
                 {
                     if (!e.shift && !e.control)
-                        System.Array.Clear(m_selection.Array, 0, m_selection.Count);
+                        ClearSelection();
 
                     if (settings.selectVertex && SelectVertex(e, selectSign, settings.selectFrontSideOnly))
                     {
@@ -702,7 +751,7 @@ namespace UTJ.NormalPainter
                         {
                             m_rectDragging = false;
                             if (!e.shift && !e.control)
-                                System.Array.Clear(m_selection.Array, 0, m_selection.Count);
+                                ClearSelection();
 
                             m_rectEndPoint = e.mousePosition;
                             handled = true;
@@ -750,7 +799,7 @@ namespace UTJ.NormalPainter
                     else if (et == EventType.MouseUp)
                     {
                         if (!e.shift && !e.control)
-                            System.Array.Clear(m_selection.Array, 0, m_selection.Count);
+                            ClearSelection();
 
                         handled = true;
                         if (!SelectLasso(m_lassoPoints.ToArray(), selectSign, settings.selectFrontSideOnly) && !m_rayHit)
@@ -764,7 +813,7 @@ namespace UTJ.NormalPainter
                 else if (selectMode == SelectMode.Brush)
                 {
                     if (et == EventType.MouseDown && !e.shift && !e.control)
-                        System.Array.Clear(m_selection.Array, 0, m_selection.Count);
+                        ClearSelection();
 
                     if (et == EventType.MouseDown || et == EventType.MouseDrag)
                     {
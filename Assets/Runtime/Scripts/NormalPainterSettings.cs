@@ -87,12 +87,16 @@ namespace UTJ.NormalPainter
         public BrushMode brushMode = BrushMode.Paint;
         public SelectMode selectMode = SelectMode.Single;
         public MirrorMode mirrorMode = MirrorMode.None;
+        public MirrorTolerance mirrorTolerance = MirrorTolerance.Exact;
+        public float mirrorEpsilon = 0.0001f;
         public bool selectFrontSideOnly = true;
         public bool selectVertex = true;
         public bool selectTriangle = true;
         public bool rotatePivot = false;
         public bool brushMaskWithSelection = true;
         public int brushBlendMode = 0;
+        public BrushFalloff brushFalloff = BrushFalloff.Euclidean;
+        public float brushSpacing = 0.25f; // distance between dabs relative to radius
 
         public BrushData[] brushData = new BrushData[5] {
             new BrushData(),
@@ -36,6 +36,12 @@ namespace UTJ.NormalPainter
         Flow,
     }
 
+    public enum BrushFalloff
+    {
+        Euclidean,
+        Geodesic,
+    }
+
     public enum SelectMode
     {
         Single,
@@ -55,6 +61,13 @@ namespace UTJ.NormalPainter
         DownToUp,
     }
 
+    public enum MirrorTolerance
+    {
+        Exact,
+        Epsilon,
+        Nearest,
+    }
+
     public enum TangentsUpdateMode
     {
         Manual,
@@ -227,6 +240,7 @@ namespace UTJ.NormalPainter
         public int num_vertices;
         public int num_triangles;
         public Matrix4x4 transform;
+        public IntPtr cache;
     }
     public struct npSkinData
     {
@@ -439,6 +453,66 @@ namespace UTJ.NormalPainter
             return false;
         }
 
+        // value of the brush at the cursor that varies along strokes. base normal of paint or value of replace in local space.
+        Vector3 GetBrushStrokeValue()
+        {
+            switch (m_settings.brushMode)
+            {
+                case BrushMode.Paint:
+                    return PickBaseNormal(m_rayPos, m_rayHitTriangle);
+                case BrushMode.Replace:
+                    return GetComponent<Transform>().worldToLocalMatrix.MultiplyVector(m_settings.assignValue).normalized;
+                default:
+                    return Vector3.zero;
+            }
+        }
+
+        // the first dab of a stroke. ApplyBrushStroke() places following dabs from here.
+        public void BeginBrushStroke(Vector3 pos, Vector3 value)
+        {
+            m_brushStroking = true;
+            m_brushLastDab = pos;
+            m_brushLastValue = value;
+            m_brushLastPressure = npGetPenPressure();
+        }
+
+        public bool ApplyBrushStroke(BrushMode mode, bool useSelection, Vector3 pos, float radius, float strength, PinnedArray<float> bsamples,
+            Vector3 value, int blendMode)
+        {
+            useSelection = useSelection && m_numSelected > 0;
+            float pressure = npGetPenPressure();
+            var points = new Vector3[] { m_brushLastDab, pos };
+            var pressures = new float[] { m_brushLastPressure, pressure };
+            var values = new Vector3[] { m_brushLastValue, value };
+            var lastDab = m_brushLastDab;
+            int ret = 0;
+            try
+            {
+                ret = npBrushStroke(ref m_npModelData, (int)mode, points, pressures, values, points.Length, m_settings.brushSpacing,
+                    radius, strength, bsamples.Length, bsamples, blendMode, m_normalsBase, useSelection, ref m_brushLastDab);
+            }
+            catch (EntryPointNotFoundException)
+            {
+                // following events apply a dab each (see HandleMouseEvent())
+                OnEntryPointNotFound("npBrushStroke");
+                return false;
+            }
+            // next call continues from the last dab, so value and pressure are taken at it as PlaceDabs() does
+            if (m_brushLastDab != lastDab)
+            {
+                float u = (m_brushLastDab - lastDab).magnitude / (pos - lastDab).magnitude;
+                var v = Vector3.Lerp(m_brushLastValue, value, u);
+                m_brushLastValue = v.sqrMagnitude > 1e-12f ? v.normalized : value;
+                m_brushLastPressure = Mathf.Lerp(m_brushLastPressure, pressure, u);
+            }
+            if (ret > 0)
+            {
+                UpdateNormals();
+                return true;
+            }
+            return false;
+        }
+
         public void ResetNormals(bool useSelection, bool pushUndo)
         {
             if (!useSelection)
@@ -555,6 +629,8 @@ namespace UTJ.NormalPainter
                 npApplySkinning(ref m_npSkinData,
                     IntPtr.Zero, m_normalsBasePredeformed, m_tangentsBasePredeformed,
                     IntPtr.Zero, m_normalsBase, m_tangentsBase);
+                if (m_npModelData.cache != IntPtr.Zero)
+                    npRefitMeshCache(ref m_npModelData);
 
                 if (m_cbPoints != null) m_cbPoints.SetData(m_points.List);
                 if (m_cbNormals != null) m_cbNormals.SetData(m_normals.List);
@@ -682,12 +758,87 @@ namespace UTJ.NormalPainter
             return false;
         }
 
+        // objects being edited are raycasted together. the hit counts only if this object is the nearest.
         public bool Raycast(Ray ray, ref int ti, ref float distance)
         {
-            bool ret = npRaycast(ref m_npModelData, ray.origin, ray.direction, ref ti, ref distance) > 0;
+            if (!s_editingPainters.Contains(this) || !HasEntryPoint("npCreateScene"))
+                return npRaycast(ref m_npModelData, ray.origin, ray.direction, ref ti, ref distance) > 0;
+            return RaycastScene(ray, ref ti, ref distance) == this;
+        }
+
+        static List<NormalPainter> s_editingPainters = new List<NormalPainter>();
+        static IntPtr s_npScene;
+
+        // nearest hit among objects being edited with a single native call.
+        // the scene's top-level tree is rebuilt only when the set of meshes changes. otherwise it is refitted.
+        static NormalPainter RaycastScene(Ray ray, ref int ti, ref float distance)
+        {
+            if (s_npScene == IntPtr.Zero)
+            {
+                try
+                {
+                    s_npScene = npCreateScene();
+                }
+                catch (EntryPointNotFoundException)
+                {
+                    OnEntryPointNotFound("npCreateScene");
+                    return RaycastEach(ray, ref ti, ref distance);
+                }
+                AssemblyReloadEvents.beforeAssemblyReload += ReleaseScene;
+            }
+
+            var models = new npMeshData[s_editingPainters.Count];
+            for (int i = 0; i < models.Length; ++i)
+                models[i] = s_editingPainters[i].m_npModelData;
+            npUpdateScene(s_npScene, models, models.Length);
+
+            int instance = -1;
+            if (npRaycastScene(s_npScene, ray.origin, ray.direction, ref instance, ref ti, ref distance) > 0)
+                return s_editingPainters[instance];
+            return null;
+        }
+
+        // nearest hit among objects being edited, raycasting them one by one. for plugins without scene support.
+        static NormalPainter RaycastEach(Ray ray, ref int ti, ref float distance)
+        {
+            NormalPainter ret = null;
+            foreach (var painter in s_editingPainters)
+            {
+                int t = 0;
+                float d = 0.0f;
+                if (npRaycast(ref painter.m_npModelData, ray.origin, ray.direction, ref t, ref d) > 0 && (ret == null || d < distance))
+                {
+                    ret = painter;
+                    ti = t;
+                    distance = d;
+                }
+            }
             return ret;
         }
 
+        static void ReleaseScene()
+        {
+            if (s_npScene != IntPtr.Zero)
+            {
+                npDestroyScene(s_npScene);
+                s_npScene = IntPtr.Zero;
+                AssemblyReloadEvents.beforeAssemblyReload -= ReleaseScene;
+            }
+        }
+
+        public bool ClosestPoint(Vector3 pos, ref int ti, ref Vector3 point, ref float distance)
+        {
+            try
+            {
+                return npClosestPoint(ref m_npModelData, pos, ref ti, ref point, ref distance) > 0;
+            }
+            catch (EntryPointNotFoundException)
+            {
+                OnEntryPointNotFound("npClosestPoint");
+                return false;
+            }
+        }
+
         public Vector3 PickNormal(Vector3 pos, int ti)
         {
             return npPickNormal(ref m_npModelData, pos, ti);
@@ -725,6 +876,7 @@ namespace UTJ.NormalPainter
         {
             for (int i = 0; i < m_selection.Count; ++i)
                 m_selection[i] = 1.0f;
+            ResetSelectionIndex();
             return m_selection.Count > 0;
         }
 
@@ -732,12 +884,14 @@ namespace UTJ.NormalPainter
         {
             for (int i = 0; i < m_selection.Count; ++i)
                 m_selection[i] = 1.0f - m_selection[i];
+            ResetSelectionIndex();
             return m_selection.Count > 0;
         }
 
         public bool ClearSelection()
         {
             System.Array.Clear(m_selection.Array, 0, m_selection.Count);
+            ResetSelectionIndex();
             return m_selection.Count > 0;
         }
 
@@ -838,6 +992,8 @@ namespace UTJ.NormalPainter
         }
 
         MirrorMode m_prevMirrorMode;
+        MirrorTolerance m_prevMirrorTolerance;
+        float m_prevMirrorEpsilon;
 
         bool ApplyMirroringInternal()
         {
@@ -849,19 +1005,36 @@ namespace UTJ.NormalPainter
                 m_mirrorRelation = new PinnedList<int>(m_points.Count);
                 needsSetup = true;
             }
-            else if(m_prevMirrorMode != m_settings.mirrorMode)
+            else if(m_prevMirrorMode != m_settings.mirrorMode ||
+                m_prevMirrorTolerance != m_settings.mirrorTolerance ||
+                m_prevMirrorEpsilon != m_settings.mirrorEpsilon)
             {
-                m_prevMirrorMode = m_settings.mirrorMode;
                 needsSetup = true;
             }
 
             Vector3 planeNormal = GetMirrorPlane(m_settings.mirrorMode);
             if (needsSetup)
             {
+                m_prevMirrorMode = m_settings.mirrorMode;
+                m_prevMirrorTolerance = m_settings.mirrorTolerance;
+                m_prevMirrorEpsilon = m_settings.mirrorEpsilon;
                 npMeshData tmp = m_npModelData;
                 tmp.vertices = m_pointsPredeformed;
                 tmp.normals = m_normalsBasePredeformed;
-                if (npBuildMirroringRelation(ref tmp, planeNormal, 0.0001f, m_mirrorRelation) == 0)
+                int numMirrored = -1;
+                if (HasEntryPoint("npBuildMirroringRelation2"))
+                {
+                    try
+                    {
+                        numMirrored = npBuildMirroringRelation2(ref tmp, planeNormal,
+                            m_settings.mirrorEpsilon, (int)m_settings.mirrorTolerance, m_mirrorRelation);
+                    }
+                    catch (EntryPointNotFoundException) { OnEntryPointNotFound("npBuildMirroringRelation2"); }
+                }
+                // plugins without npBuildMirroringRelation2() match exactly only
+                if (numMirrored == -1)
+                    numMirrored = npBuildMirroringRelation(ref tmp, planeNormal, m_settings.mirrorEpsilon, m_mirrorRelation);
+                if (numMirrored == 0)
                 {
                     Debug.LogWarning("NormalEditor: this mesh seems not symmetric");
                     m_mirrorRelation = null;
@@ -1272,6 +1445,30 @@ namespace UTJ.NormalPainter
             if (pushUndo) PushUndo();
         }
 
+        public void ApplyProjectionNearest(GameObject go, bool pushUndo)
+        {
+            var mdata = new MeshData();
+            if (mdata.Extract(go))
+                ApplyProjectionNearest(mdata, pushUndo);
+        }
+        public void ApplyProjectionNearest(MeshData normalSource, bool pushUndo)
+        {
+            bool mask = m_numSelected > 0;
+            var np = (npMeshData)normalSource;
+            try
+            {
+                npProjectNormalsNearest(ref m_npModelData, ref np, mask);
+            }
+            catch (EntryPointNotFoundException)
+            {
+                OnEntryPointNotFound("npProjectNormalsNearest");
+                return;
+            }
+
+            UpdateNormals();
+            if (pushUndo) PushUndo();
+        }
+
 
         public void ResetToBindpose(bool pushUndo)
         {
@@ -1315,9 +1512,67 @@ namespace UTJ.NormalPainter
             AssetDatabase.CreateAsset(Instantiate(m_settings), path);
         }
 
+        // prebuilt plugins may predate some entry points. a missing one is detected on its first call, and the callers
+        // fall back to what the plugin provides (no mesh cache, a dab per event, raycasting objects one by one).
+        static HashSet<string> s_npMissingEntryPoints = new HashSet<string>();
+
+        static bool HasEntryPoint(string name)
+        {
+            return !s_npMissingEntryPoints.Contains(name);
+        }
+
+        static void OnEntryPointNotFound(string name)
+        {
+            if (s_npMissingEntryPoints.Add(name))
+                Debug.LogWarning("NormalPainter: " + name + "() is not found in NormalPainterCore. the plugin is outdated.");
+        }
+
+        IntPtr CreateMeshCache()
+        {
+            if (HasEntryPoint("npCreateMeshCache"))
+            {
+                try { return npCreateMeshCache(ref m_npModelData); }
+                catch (EntryPointNotFoundException) { OnEntryPointNotFound("npCreateMeshCache"); }
+            }
+            return IntPtr.Zero;
+        }
+
+        void ResetSelectionIndex()
+        {
+            if (HasEntryPoint("npResetSelectionIndex"))
+            {
+                try { npResetSelectionIndex(ref m_npModelData); }
+                catch (EntryPointNotFoundException) { OnEntryPointNotFound("npResetSelectionIndex"); }
+            }
+        }
+
+        void SetBrushFalloff(BrushFalloff falloff)
+        {
+            if (HasEntryPoint("npSetBrushFalloff"))
+            {
+                try { npSetBrushFalloff(ref m_npModelData, (int)falloff); }
+                catch (EntryPointNotFoundException) { OnEntryPointNotFound("npSetBrushFalloff"); }
+            }
+        }
+
+        [DllImport("NormalPainterCore")] static extern IntPtr npCreateMeshCache(ref npMeshData model);
+        [DllImport("NormalPainterCore")] static extern void npRefitMeshCache(ref npMeshData model);
+        [DllImport("NormalPainterCore")] static extern void npDestroyMeshCache(IntPtr cache);
+        [DllImport("NormalPainterCore")] static extern void npResetSelectionIndex(ref npMeshData model);
+        [DllImport("NormalPainterCore")] static extern void npSetBrushFalloff(ref npMeshData model, int falloff);
+
         [DllImport("NormalPainterCore")] static extern int npRaycast(
             ref npMeshData model, Vector3 pos, Vector3 dir, ref int tindex, ref float distance);
 
+        [DllImport("NormalPainterCore")] static extern IntPtr npCreateScene();
+        [DllImport("NormalPainterCore")] static extern void npDestroyScene(IntPtr scene);
+        [DllImport("NormalPainterCore")] static extern void npUpdateScene(IntPtr scene, npMeshData[] models, int num_models);
+        [DllImport("NormalPainterCore")] static extern int npRaycastScene(
+            IntPtr scene, Vector3 pos, Vector3 dir, ref int instance, ref int tindex, ref float distance);
+
+        [DllImport("NormalPainterCore")] static extern int npClosestPoint(
+            ref npMeshData model, Vector3 pos, ref int tindex, ref Vector3 point, ref float distance);
+
         [DllImport("NormalPainterCore")] static extern Vector3 npPickNormal(
             ref npMeshData model, Vector3 pos, int ti);
 
@@ -1381,6 +1636,12 @@ namespace UTJ.NormalPainter
             ref npMeshData model,
             Vector3 pos, float radius, float strength, int num_bsamples, IntPtr bsamples, IntPtr baseNormals, IntPtr normals, bool mask);
 
+        [DllImport("NormalPainterCore")] static extern int npBrushStroke(
+            ref npMeshData model, int brush_mode,
+            Vector3[] points, float[] pressures, Vector3[] values, int num_points, float spacing,
+            float radius, float strength, int num_bsamples, IntPtr bsamples, int blend_mode, IntPtr baseNormals, bool mask,
+            ref Vector3 lastDab);
+
         [DllImport("NormalPainterCore")] static extern int npAssign(
             ref npMeshData model, Vector3 value);
         
@@ -1407,6 +1668,8 @@ namespace UTJ.NormalPainter
 
         [DllImport("NormalPainterCore")] static extern int npBuildMirroringRelation(
             ref npMeshData model, Vector3 plane_normal, float epsilon, IntPtr relation);
+        [DllImport("NormalPainterCore")] static extern int npBuildMirroringRelation2(
+            ref npMeshData model, Vector3 plane_normal, float epsilon, int tolerance, IntPtr relation);
 
         [DllImport("NormalPainterCore")] static extern void npApplyMirroring(
             int num_vertices, IntPtr relation, Vector3 plane_normal, IntPtr normals);
@@ -1415,6 +1678,8 @@ namespace UTJ.NormalPainter
             ref npMeshData model, ref npMeshData target, IntPtr ray_dir, bool mask);
         [DllImport("NormalPainterCore")] static extern void npProjectNormals2(
             ref npMeshData model, ref npMeshData target, Vector3 ray_dir, bool mask);
+        [DllImport("NormalPainterCore")] static extern void npProjectNormalsNearest(
+            ref npMeshData model, ref npMeshData target, bool mask);
 
         [DllImport("NormalPainterCore")] static extern void npApplySkinning(
             ref npSkinData skin,
@@ -1432,6 +1697,7 @@ namespace UTJ.NormalPainter
             ref npMeshData model, IntPtr dst);
 
         [DllImport("NormalPainterCore")] static extern void npInitializePenInput();
+        [DllImport("NormalPainterCore")] static extern float npGetPenPressure();
 #endif // UNITY_EDITOR
     }
 }